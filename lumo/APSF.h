@@ -67,9 +67,9 @@
 #define APSF_H
 
 #include <cmath>
-#include <gl/glut.h>
+#include <cstdio>
 #include <vector>
-#include "ppm\ppm.hpp"
+#include "ppm/ppm.hpp"
 
 using namespace std;
 
@@ -89,8 +89,8 @@ typedef std::vector<int> IntVector;
 
 ///
 
-BLUE_NOISE::BLUE_NOISE(float _radius, bool _isTiled, bool usesGrid) :
-	m_rng(123456),
+BLUE_NOISE::BLUE_NOISE(float _radius, bool _isTiled, bool usesGrid, unsigned long seed) :
+	m_rng(seed),
 	radius(_radius),
 	isTiled(_isTiled)
 {
@@ -321,79 +321,137 @@ void BLUE_NOISE::maximize()
 	}
 }
 
+	// clip a convex polygon, centered on the origin, to the half plane
+	// of points closer to the origin than to _d_
+static void clipPolygon(std::vector<Vec2> &poly, Vec2 d, std::vector<Vec2> &out)
+{
+	float limit = .5f*(d.x*d.x + d.y*d.y);
+	int N = (int) poly.size();
+
+	out.clear();
+	for (int i=0; i<N; i++) {
+		Vec2 &a = poly[i], &b = poly[(i+1)%N];
+		float da = a.x*d.x + a.y*d.y - limit;
+		float db = b.x*d.x + b.y*d.y - limit;
+
+		if (da<=0) out.push_back(a);
+		if ((da<0 && db>0) || (da>0 && db<0)) {
+			float t = da/(da-db);
+			out.push_back(Vec2(a.x + t*(b.x-a.x), a.y + t*(b.y-a.y)));
+		}
+	}
+	poly.swap(out);
+}
+
 void BLUE_NOISE::relax()
 {
-	FILE *tmp = fopen("relaxTmpIn.txt","w");
-	int dim, numVerts, numFaces;
-	Vec2 *verts = 0;
 	int numPoints = (int) points.size();
-
-		// will overwrite later
-	fprintf(tmp, "2                  \n");
-	for (int i=0; i<(int) points.size(); i++) {
-		Vec2 &pt = points[i];
-		fprintf(tmp, "%f %f\n", pt.x, pt.y);
+	if (!numPoints) return;
+
+		// bucket the points, the same size as the search grid
+	int G = (int) ceil(2./(4.*radius));
+	if (G<2) G = 2;
+	float bucketSize = 2.0f/G;
+	std::vector<int> start(G*G+1, 0), order(numPoints), buckets(numPoints);
+	for (int i=0; i<numPoints; i++) {
+		int bx = (int) floor(.5*(points[i].x + 1)*G);
+		int by = (int) floor(.5*(points[i].y + 1)*G);
+		bx = bx<0 ? 0 : (bx>=G ? G-1 : bx);
+		by = by<0 ? 0 : (by>=G ? G-1 : by);
+		buckets[i] = by*G + bx;
+		start[buckets[i]+1]++;
 	}
-	for (int y=-1; y<=1; y++) {
-		for (int x=-1; x<=1; x++) {
-			if (x || y) {
-				for (int i=0; i<(int) points.size(); i++) {
-					Vec2 &pt = points[i];
-					if (fabs(pt.x+x*2)-1<radius*4 || fabs(pt.y+y*2)-1<radius*4) {
-						fprintf(tmp, "%f %f\n", pt.x+x*2, pt.y+y*2);
-						numPoints++;
+	for (int i=0; i<G*G; i++)
+		start[i+1] += start[i];
+	std::vector<int> next(start.begin(), start.end()-1);
+	for (int i=0; i<numPoints; i++)
+		order[next[buckets[i]]++] = i;
+
+		// build each Voronoi cell by clipping a square around the point
+		// against its neighbors. Neighbors further than R can't touch
+		// a cell that fits in R/2, otherwise search further out.
+	std::vector<Vec2> relaxed(numPoints), poly, scratch;
+	for (int i=0; i<numPoints; i++) {
+		Vec2 &pt = points[i];
+		int bx = buckets[i]%G, by = buckets[i]/G;
+
+		for (float R=4*radius; ; R*=2) {
+			poly.clear();
+			float x0 = -R, x1 = R, y0 = -R, y1 = R;
+			if (!isTiled) {
+				if (x0 < -1-pt.x) x0 = -1-pt.x;
+				if (x1 > 1-pt.x) x1 = 1-pt.x;
+				if (y0 < -1-pt.y) y0 = -1-pt.y;
+				if (y1 > 1-pt.y) y1 = 1-pt.y;
+			}
+			poly.push_back(Vec2(x0, y0));
+			poly.push_back(Vec2(x1, y0));
+			poly.push_back(Vec2(x1, y1));
+			poly.push_back(Vec2(x0, y1));
+
+			int N = (int) ceil(R/bucketSize);
+			if (N>(G>>1)) N = G>>1;
+			for (int j=-N; j<=N; j++) {
+				for (int k=-N; k<=N; k++) {
+					int cx = bx+k, cy = by+j;
+					if (isTiled) {
+						cx = (cx+G)%G;
+						cy = (cy+G)%G;
+					} else if (cx<0 || cx>=G || cy<0 || cy>=G) {
+						continue;
+					}
+
+					int cell = cy*G + cx;
+					for (int m=start[cell]; m<start[cell+1]; m++) {
+						if (order[m]==i) continue;
+						Vec2 d = getTiled(points[order[m]] - pt);
+						if (d.x*d.x + d.y*d.y < R*R)
+							clipPolygon(poly, d, scratch);
 					}
 				}
 			}
-		}
-	}
-	fseek(tmp, 0, 0);
-	fprintf(tmp, "2 %d", numPoints);
-	fclose(tmp);
-
-	tmp = fopen("relaxTmpOut.txt", "w");
-	fclose(tmp);
-	system("qvoronoi p FN < relaxTmpIn.txt > relaxTmpOut.txt");
 
-	tmp = fopen("relaxTmpOut.txt", "r");
-	fscanf(tmp, "%d\n%d\n", &dim, &numVerts);
-
-	if (dim!=2) {
-		printf("Error calling out to qvoronoi, skipping relaxation.\n");
-		goto exit;
-	}
-
-	verts = new Vec2[numVerts];
-	for (int i=0; i<numVerts; i++) {
-		fscanf(tmp, "%f %f\n", &verts[i].x, &verts[i].y);
-	}
-
-	fscanf(tmp, "%d\n", &numFaces);
-
-	for (int i=0; i<(int) points.size(); i++) {
-		Vec2 center(0,0);
-		int N, skip=0;
-
-		fscanf(tmp, "%d", &N);
-		for (int j=0; j<N; j++) {
-			int index;
-
-			fscanf(tmp, "%d", &index);
-			if (index<0) {
-				skip = 1;
-			} else {
-				center += verts[index];
+				// done if the cell is small enough to have seen every
+				// neighbor that could touch it, or the search covers
+				// the whole domain
+			float farthest = 0;
+			for (int j=0; j<(int) poly.size(); j++) {
+				float d = poly[j].x*poly[j].x + poly[j].y*poly[j].y;
+				if (d>farthest) farthest = d;
 			}
+			if (farthest <= .25f*R*R || N==(G>>1) || R>=1)
+				break;
 		}
 
-		if (!skip) {
-			center *= (1.0f/N);
-			points[i] = getTiled(center);
+			// move to the centroid of the cell
+		float area = 0, cx = 0, cy = 0;
+		for (int j=0; j<(int) poly.size(); j++) {
+			Vec2 &a = poly[j], &b = poly[(j+1)%poly.size()];
+			float cross = a.x*b.y - b.x*a.y;
+			area += cross;
+			cx += (a.x + b.x)*cross;
+			cy += (a.y + b.y)*cross;
+		}
+		if (area>0) {
+			relaxed[i] = getTiled(Vec2(pt.x + cx/(3*area), pt.y + cy/(3*area)));
+		} else {
+			relaxed[i] = pt;
 		}
 	}
 
-exit:
-	if (verts) delete verts;
+	points.swap(relaxed);
+
+		// the search grid still has the old positions
+	if (m_grid) {
+		for (int i=0; i<m_gridSize*m_gridSize; i++)
+			for (int k=0; k<kMaxPointsPerCell; k++)
+				m_grid[i][k] = -1;
+
+		std::vector<Vec2> moved;
+		moved.swap(points);
+		for (int i=0; i<(int) moved.size(); i++)
+			addPoint(moved[i]);
+	}
 }
 
 ///
@@ -75,12 +75,19 @@
 
 // $Id: PDSampling.h,v 1.6 2006/07/06 23:13:18 zr Exp $
 
+#ifndef BLUE_NOISE_H
+#define BLUE_NOISE_H
+
 #include "RNG.h"
+#include "../PHILOX.h"
 #include <cmath>
 #include <vector>
 
 #define kMaxPointsPerCell 9
 
+// seed the generator starts from unless told otherwise
+#define BLUE_NOISE_SEED PHILOX_SEED
+
 class RangeList;
 class ScallopedRegion;
 
@@ -121,7 +128,7 @@ public:
 /// method is the only one available.
 class BLUE_NOISE {
 protected:
-	RNG m_rng;
+	PHILOX m_rng;
 	std::vector<int> m_neighbors;
 	
 	int (*m_grid)[kMaxPointsPerCell];
@@ -134,7 +141,7 @@ public:
 	bool isTiled;
 
 public:
-	BLUE_NOISE(float radius, bool isTiled=true, bool usesGrid=true);
+	BLUE_NOISE(float radius, bool isTiled=true, bool usesGrid=true, unsigned long seed=BLUE_NOISE_SEED);
 	virtual ~BLUE_NOISE() { };
 
 	//
@@ -174,10 +181,13 @@ public:
 		// full
 	void maximize();
 
-		// apply one step of Lloyd relaxation
+		// apply one step of Lloyd relaxation, moving each point
+		// to the centroid of its Voronoi cell
 	void relax();
 
 	void complete();
 
   void writeToBool(bool* noise, int size);
 };
+
+#endif
@@ -64,162 +64,119 @@
 // 
 
 #include "CELL.h"
+#include "CELL_POOL.h"
+#include <new>
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-// normal cell constructor
-CELL::CELL(float north, float east, float south, float west, CELL* parent, int depth) : 
-  parent(parent), depth(depth), index(-1), candidate(false),
-  boundary(false), potential(0.0f), state(EMPTY)
+CELL::CELL(int depth, int ix, int iy, CELL* parent) : 
+  children(NULL), parent(parent), potential(0.0f), index(-1),
+  ix(ix), iy(iy), depth(depth), state(EMPTY), candidate(false), boundary(false)
 {
   for (int x = 0; x < 4; x++)
-    children[x] = NULL;
-  for (int x = 0; x < 8; x++)
-    neighbors[x] = NULL;
-
-  bounds[0] = north; bounds[1] = east; bounds[2] = south; bounds[3] = west;
-
-  center[0] = (bounds[1] + bounds[3]) * 0.5f;
-  center[1] = (bounds[0] + bounds[2]) * 0.5f;
+    adjacent[x] = NULL;
 }
 
-// ghost cell constructor
-CELL::CELL(int depth) : parent(NULL), depth(depth), index(-1), candidate(false),
-  boundary(true), potential(0.0f), state(EMPTY)
-{
-  for (int x = 0; x < 4; x++)
-    children[x] = NULL;
-  for (int x = 0; x < 8; x++)
-    neighbors[x] = NULL;
-  
-  bounds[0] = 0.0f; bounds[1] = 0.0f; bounds[2] = 0.0f; bounds[3] = 0.0f; 
-  center[0] = 0.0f; center[1] = 0.0f;
-}
+// children along each face, in the order that matches the children
+// across that face of a neighbor
+static const int faceChildren[4][2] = {{0, 1}, {1, 2}, {3, 2}, {0, 3}};
 
-CELL::~CELL() {
-  int x;
-
-  for (x = 0; x < 4; x++)
-    if (children[x] != NULL)
-    {
-      delete children[x];
-      children[x] = NULL;
-    }
-}
+// children of the neighbor across each face that touch the face,
+// in the winding order of the neighbors
+static const int facingChildren[4][2] = {{3, 2}, {0, 3}, {1, 0}, {2, 1}};
 
 //////////////////////////////////////////////////////////////////////
 // refine current cell
 //////////////////////////////////////////////////////////////////////
-void CELL::refine() {
-  if (children[0] != NULL) return;
-  float center[] = {(bounds[0] + bounds[2]) * 0.5f, (bounds[1] + bounds[3]) * 0.5f};
+void CELL::refine(CELL_POOL& pool) {
+  if (children != NULL) return;
  
-  children[0] = new CELL(bounds[0], center[1], center[0], bounds[3], this, depth + 1);
-  children[1] = new CELL(bounds[0], bounds[1], center[0], center[1], this, depth + 1);
-  children[2] = new CELL(center[0], bounds[1], bounds[2], center[1], this, depth + 1);
-  children[3] = new CELL(center[0], center[1], bounds[2], bounds[3], this, depth + 1);
-
-  children[0]->potential = potential;
-  children[1]->potential = potential;
-  children[2]->potential = potential;
-  children[3]->potential = potential;
-}
-
-//////////////////////////////////////////////////////////////////////
-// return north neighbor to current cell
-//////////////////////////////////////////////////////////////////////
-CELL* CELL::northNeighbor()
-{
-  // if it is the root
-  if (this->parent == NULL) return NULL;
-
-  // if it is the southern child of the parent
-  if (parent->children[3] == this) return parent->children[0];
-  if (parent->children[2] == this) return parent->children[1];
-
-  // else look up higher
-  CELL* mu = parent->northNeighbor();
+  // the four children sit next to each other in one block,
+  // north is the upper half of the square
+  children = pool.siblings();
+  new (children)     CELL(depth + 1, 2 * ix,     2 * iy + 1, this);
+  new (children + 1) CELL(depth + 1, 2 * ix + 1, 2 * iy + 1, this);
+  new (children + 2) CELL(depth + 1, 2 * ix + 1, 2 * iy,     this);
+  new (children + 3) CELL(depth + 1, 2 * ix,     2 * iy,     this);
 
-  // if there are no more children to look at,
-  // this is the answer
-  if (mu == NULL || mu->children[0] == NULL) return mu;
-  // if it is the NW child of the parent
-  else if (parent->children[0] == this) return mu->children[3];
-  // if it is the NE child of the parent
-  else return mu->children[2];
+  for (int x = 0; x < 4; x++)
+    children[x].potential = potential;
+
+  // siblings see each other
+  child(0)->adjacent[1] = child(1); child(1)->adjacent[3] = child(0);
+  child(3)->adjacent[1] = child(2); child(2)->adjacent[3] = child(3);
+  child(0)->adjacent[2] = child(3); child(3)->adjacent[0] = child(0);
+  child(1)->adjacent[2] = child(2); child(2)->adjacent[0] = child(1);
+
+  // across each face of this cell
+  for (int face = 0; face < 4; face++)
+  {
+    CELL* neighbor = adjacent[face];
+    int opposite = (face + 2) % 4;
+    for (int x = 0; x < 2; x++)
+    {
+      CELL* current = child(faceChildren[face][x]);
+
+      // a coarser or unrefined neighbor is also the children's
+      if (neighbor == NULL || neighbor->leaf())
+      {
+        current->adjacent[face] = neighbor;
+        continue;
+      }
+
+      // otherwise its children across the face match up with ours,
+      // and they and their descendants along the face pointed at us
+      CELL* facing = neighbor->child(faceChildren[opposite][x]);
+      current->adjacent[face] = facing;
+      setAdjacent(facing, opposite, current);
+    }
+  }
 }
 
 //////////////////////////////////////////////////////////////////////
-// return north neighbor to current cell
+// point a cell, and its descendants along a face, at a new neighbor
 //////////////////////////////////////////////////////////////////////
-CELL* CELL::southNeighbor()
+void CELL::setAdjacent(CELL* cell, int face, CELL* neighbor)
 {
-  // if it is the root
-  if (this->parent == NULL) return NULL;
-
-  // if it is the northern child of the parent
-  if (parent->children[0] == this) return parent->children[3];
-  if (parent->children[1] == this) return parent->children[2];
+  cell->adjacent[face] = neighbor;
+  if (cell->leaf()) return;
 
-  // else look up higher
-  CELL* mu = parent->southNeighbor();
-
-  // if there are no more children to look at,
-  // this is the answer
-  if (mu == NULL || mu->children[0] == NULL) return mu;
-  // if it is the SW child of the parent
-  else if (parent->children[3] == this) return mu->children[0];
-  // if it is the SE child of the parent
-  else return mu->children[1];
+  setAdjacent(cell->child(faceChildren[face][0]), face, neighbor);
+  setAdjacent(cell->child(faceChildren[face][1]), face, neighbor);
 }
 
 //////////////////////////////////////////////////////////////////////
-// return north neighbor to current cell
+// physical bound of the cell
 //////////////////////////////////////////////////////////////////////
-CELL* CELL::westNeighbor()
+float CELL::bounds(int side) const
 {
-  // if it is the root
-  if (this->parent == NULL) return NULL;
-
-  // if it is the eastern child of the parent
-  if (parent->children[1] == this) return parent->children[0];
-  if (parent->children[2] == this) return parent->children[3];
-
-  // else look up higher
-  CELL* mu = parent->westNeighbor();
-
-  // if there are no more children to look at,
-  // this is the answer
-  if (mu == NULL || mu->children[0] == NULL) return mu;
-  // if it is the NW child of the parent
-  else if (parent->children[0] == this) return mu->children[1];
-  // if it is the SW child of the parent
-  else return mu->children[2];
+  switch (side) {
+    case 0:  return (iy + 1) * size();
+    case 1:  return (ix + 1) * size();
+    case 2:  return iy * size();
+    default: return ix * size();
+  }
 }
 
 //////////////////////////////////////////////////////////////////////
-// return north neighbor to current cell
+// the leaves across the faces of a leaf
 //////////////////////////////////////////////////////////////////////
-CELL* CELL::eastNeighbor()
+void CELL::neighbors(CELL* found[8]) const
 {
-  // if it is the root
-  if (this->parent == NULL) return NULL;
-
-  // if it is the western child of the parent
-  if (parent->children[0] == this) return parent->children[1];
-  if (parent->children[3] == this) return parent->children[2];
-
-  // else look up higher
-  CELL* mu = parent->eastNeighbor();
-
-  // if there are no more children to look at,
-  // this is the answer
-  if (mu == NULL || mu->children[0] == NULL) return mu;
-  // if it is the NE child of the parent
-  else if (parent->children[1] == this) return mu->children[0];
-  // if it is the SE child of the parent
-  else return mu->children[3];
+  for (int face = 0; face < 4; face++)
+  {
+    CELL* neighbor = adjacent[face];
+    if (neighbor == NULL || neighbor->leaf())
+    {
+      found[2 * face]     = neighbor;
+      found[2 * face + 1] = NULL;
+    }
+    else
+    {
+      found[2 * face]     = neighbor->child(facingChildren[face][0]);
+      found[2 * face + 1] = neighbor->child(facingChildren[face][1]);
+    }
+  }
 }
-
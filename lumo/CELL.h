@@ -67,34 +67,35 @@
 #define CELL_H
 #include <cstdlib>
 
+class CELL_POOL;
+
 //////////////////////////////////////////////////////////////////////
 /// \enum Possible states of the cell in the DBM simulation
 //////////////////////////////////////////////////////////////////////
-enum CELL_STATE {EMPTY, NEGATIVE, POSITIVE, REPULSOR, ATTRACTOR};
+enum CELL_STATE : unsigned char {EMPTY, NEGATIVE, POSITIVE, REPULSOR, ATTRACTOR};
 
 //////////////////////////////////////////////////////////////////////
 /// \brief Basic cell data structure of the quadtree
+///
+/// Cells of a tree live in a CELL_POOL and own nothing, so they are
+/// never deleted one by one.
+///
+/// A cell only stores the links of the tree and the DBM state, and is
+/// placed by its integer square (ix, iy) on the grid of its depth, so
+/// it fits in one 64 byte cache line. Its bounds and center are
+/// computed when asked for. The solver works on the flat arrays of
+/// POISSON_SYSTEM, which computes the stencils while assembling.
 //////////////////////////////////////////////////////////////////////
 class CELL  
 {
 public:
-  //! normal cell constructor  
-  CELL(float north, 
-       float east, 
-       float south, 
-       float west, 
-       CELL* parent = NULL, 
-       int depth = 0);
-  
-  //! ghost cell constructor  
-  CELL(int depth = 0);
-
-  //! destructor
-  ~CELL();
-  
-  //! The children of the node in the quadtree
+  //! cell covering grid square (ix, iy) at 'depth'
+  CELL(int depth = 0, int ix = 0, int iy = 0, CELL* parent = NULL);
+
+  //! The first of the children in the quadtree, NULL for a leaf
   /*! 
-      Winding order of children is:
+      The four children sit next to each other in one pool block,
+      use child() to get at them. Winding order of children is:
 
       \verbatim
         _________
@@ -105,90 +106,90 @@ public:
         | 3 | 2 |   
         |___|___|
       \endverbatim */
-  CELL* children[4]; 
-  
-  //! The physical bounds of the current grid cell
-  /*! 
-      Winding order of bounds is:
+  CELL* children; 
 
-      \verbatim
-        0 - north
-        1 - east
-        2 - south
-        3 - west
-      \endverbatim */
-  float bounds[4];
+  CELL* parent;       ///< parent node in the quadtree
 
-  //! The neighbors in the balanced quadtree
+  //! The face neighbors, in the same winding order as the bounds
   /*!
-    winding order of the neighbors is:
-  
-    \verbatim
-         | 0  | 1  |
-     ____|____|____|_____
-         |         |
-       7 |         |  2
-     ____|         |_____
-         |         |
-       6 |         |  3
-     ____|_________|_____
-         |    |    |
-         | 5  |  4 |
-    \endverbatim
- 
-    Neighbors 0,2,4,6 should always exist. Depending on
-    if the neighbor is on a lower refinement level,
-    neighbors 1,3,5,7 may or may not exist. If they are not
-    present, the pointer value should ne NULL.  */
-  CELL* neighbors[8];
-
-  //! Poisson stencil coefficients
-  /*!
-    winding order of the stencil coefficients:
-  
-    \verbatim
-         | 0  | 1  |
-     ____|____|____|_____
-         |         |
-      7  |         |  2
-     ____|    8    |_____
-         |         |
-      6  |         |  3
-     ____|_________|_____
-         |    |    |
-         | 5  | 4  |
-    \endverbatim
-    Stencils 0,2,4,6 should always exist. Depending on
-    if the neighbor is on a lower refinement level,
-    stencils 1,3,5,7 may or may not exist. If they are not
-    present, the pointer value should ne NULL.    */
-  float stencil[9];
-  
-  float center[2];    ///< center of the cell
-  int depth;          ///< current tree depth
-  bool candidate;     ///< already a member of candidate list?
+    Each is the neighbor at the same depth if there is one, otherwise
+    the coarser leaf covering that side, or NULL on the edge of the
+    domain. refine() keeps them current for the whole tree, so the
+    lookups below are plain loads. */
+  CELL* adjacent[4];
 
-  CELL* parent;       ///< parent node in the quadtree
+  float potential;    ///< current electric potential
+  int index;          ///< lexicographic index for the solver
+
+  unsigned short ix;  ///< x index of the grid square covered at this depth
+  unsigned short iy;  ///< y index of the grid square covered at this depth
+  unsigned char depth;///< current tree depth
   CELL_STATE state;   ///< DBM state of the cell
+  bool candidate;     ///< already a member of candidate list?
+  bool boundary;      ///< boundary node to include in the solver?
+
+  void refine(CELL_POOL& pool);  ///< subdivide the cell, with children from the pool
 
-  void refine();      ///< subdivide the cell
+  //! is the cell a leaf of the quadtree?
+  bool leaf() const { return children == NULL; };
+
+  //! child in the winding order above, the cell must not be a leaf
+  CELL* child(int x) const { return children + x; };
 
   ////////////////////////////////////////////////////////////////
-  // solver-related variables
+  // geometry, the root covers the unit square
   ////////////////////////////////////////////////////////////////
-  bool boundary;      ///< boundary node to include in the solver?
-  float potential;    ///< current electric potential
-  float b;            ///< rhs of the linear system
-  float residual;     ///< residual in the linear solver
-  int index;          ///< lexicographic index for the solver
+
+  //! width and height of the cell
+  float size() const { return 1.0f / (float)(1 << depth); };
+
+  //! center of the cell, axis 0 is x and axis 1 is y
+  float center(int axis) const { return ((axis ? iy : ix) + 0.5f) * size(); };
+
+  /// \brief physical bound of the cell
+  ///
+  /// Winding order of bounds is:
+  ///
+  /// \verbatim
+  ///   0 - north
+  ///   1 - east
+  ///   2 - south
+  ///   3 - west
+  /// \endverbatim
+  float bounds(int side) const;
+
+  /// \brief the leaves across the faces of a leaf in the balanced quadtree
+  ///
+  /// Winding order of the neighbors is:
+  ///
+  /// \verbatim
+  ///      | 0  | 1  |
+  ///  ____|____|____|_____
+  ///      |         |
+  ///    7 |         |  2
+  ///  ____|         |_____
+  ///      |         |
+  ///    6 |         |  3
+  ///  ____|_________|_____
+  ///      |    |    |
+  ///      | 5  |  4 |
+  /// \endverbatim
+  ///
+  /// Neighbors 1,3,5,7 are only there if that side is more refined.
+  /// Neighbors 0,2,4,6 are NULL on the edge of the domain.
+  void neighbors(CELL* found[8]) const;
 
   ////////////////////////////////////////////////////////////////
   // neighbor lookups
   ////////////////////////////////////////////////////////////////
-  CELL* northNeighbor();  ///< lookup northern neighbor
-  CELL* southNeighbor();  ///< lookup southern neighbor
-  CELL* westNeighbor();   ///< lookup western neighbor
-  CELL* eastNeighbor();   ///< lookup eastern neighbor
+  CELL* northNeighbor() { return adjacent[0]; };  ///< lookup northern neighbor
+  CELL* southNeighbor() { return adjacent[2]; };  ///< lookup southern neighbor
+  CELL* westNeighbor()  { return adjacent[3]; };  ///< lookup western neighbor
+  CELL* eastNeighbor()  { return adjacent[1]; };  ///< lookup eastern neighbor
+
+private:
+  //! point a cell, and its descendants along a face, at a new neighbor
+  static void setAdjacent(CELL* cell, int face, CELL* neighbor);
 };
 
 #endif
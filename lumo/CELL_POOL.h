@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : CELL_POOL.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef CELL_POOL_H
+#define CELL_POOL_H
+
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+class CELL;
+
+//! sibling blocks in each chunk of the pool
+#define CELL_POOL_CHUNK 1024
+
+//! alignment of every sibling block, one cache line
+#define CELL_POOL_ALIGNMENT 64
+
+//////////////////////////////////////////////////////////////////////
+/// \brief Arena the quadtree cells are allocated from
+///
+/// Cells come in sibling blocks of four, stored next to each other
+/// and starting on a cache line, carved out of large chunks instead of
+/// one heap allocation per cell. Cells are never freed one at a time.
+/// The whole tree goes away at once when the pool is destroyed or
+/// cleared, without walking it, since cells own nothing themselves.
+//////////////////////////////////////////////////////////////////////
+class CELL_POOL
+{
+public:
+  //! constructor
+  CELL_POOL();
+
+  //! destructor, releases every cell at once
+  ~CELL_POOL();
+
+  /// \brief storage for four sibling cells
+  ///
+  /// The cells are not constructed, callers construct them in place.
+  CELL* siblings();
+
+  //! release every cell at once
+  void clear();
+
+  //! sibling blocks handed out so far
+  int blocks() const { return _blocks; };
+
+private:
+  //! chunks as allocated, and aligned to CELL_POOL_ALIGNMENT
+  vector<char*> _chunks;
+  vector<char*> _aligned;
+
+  //! bytes per sibling block, rounded up to the alignment
+  size_t _blockSize;
+
+  //! blocks used in the last chunk
+  int _used;
+
+  //! blocks handed out in total
+  int _blocks;
+
+  // the pool owns raw memory, so it can't be copied
+  CELL_POOL(const CELL_POOL&);
+  CELL_POOL& operator=(const CELL_POOL&);
+};
+
+#endif
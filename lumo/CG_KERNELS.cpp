@@ -0,0 +1,288 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : CG_KERNELS.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "CG_KERNELS.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <malloc.h>
+#endif
+
+// keep every multiply and add separately rounded, or the backends
+// would stop agreeing with each other
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// scalar kernels
+//////////////////////////////////////////////////////////////////////
+static float dotScalar(const float* x, const float* y, int size)
+{
+  float partial[CG_KERNEL_LANES];
+  for (int i = 0; i < CG_KERNEL_LANES; i++)
+    partial[i] = 0.0f;
+  
+  int i = 0;
+  for (; i + CG_KERNEL_LANES <= size; i += CG_KERNEL_LANES)
+    for (int j = 0; j < CG_KERNEL_LANES; j++)
+      partial[j] += x[i + j] * y[i + j];
+
+  float sum = reduceLanes(partial);
+  for (; i < size; i++)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+static void saxpyScalar(float a, const float* x, float* y, int size)
+{
+  for (int i = 0; i < size; i++)
+    y[i] += a * x[i];
+}
+
+static void saypxScalar(float a, const float* x, float* y, int size)
+{
+  for (int i = 0; i < size; i++)
+    y[i] = x[i] + a * y[i];
+}
+
+static float maxScalar(const float* x, int size)
+{
+  float maxX = 0.0f;
+  for (int i = 0; i < size; i++)
+    maxX = (x[i] > maxX) ? x[i] : maxX;
+  return maxX;
+}
+
+static void multiplyScalar(int rows, int slots, 
+                           const int* columns, const float* values, const float* diagonal,
+                           const float* x, float* y, int begin, int end)
+{
+  for (int i = begin; i < end; i++)
+  {
+    float neighborSum = 0.0f;
+    for (int s = 0; s < slots; s++)
+      neighborSum += x[columns[s * rows + i]] * values[s * rows + i];
+    y[i] = neighborSum + x[i] * diagonal[i];
+  }
+}
+
+static float updateScalar(float alpha, float beta, const float* u, const float* w,
+                          float* p, float* s, float* x, float* r, int size)
+{
+  float maxR = 0.0f;
+  for (int i = 0; i < size; i++)
+  {
+    p[i] = u[i] + beta * p[i];
+    s[i] = w[i] + beta * s[i];
+    x[i] += alpha * p[i];
+    r[i] -= alpha * s[i];
+    maxR = (r[i] > maxR) ? r[i] : maxR;
+  }
+  return maxR;
+}
+
+static void multiplyDotScalar(int rows, int slots, 
+                              const int* columns, const float* values, const float* diagonal,
+                              const float* u, const float* r, float* w, float* gamma, float* delta,
+                              int begin, int end)
+{
+  float gammas[CG_KERNEL_LANES];
+  float deltas[CG_KERNEL_LANES];
+  for (int i = 0; i < CG_KERNEL_LANES; i++)
+    gammas[i] = deltas[i] = 0.0f;
+
+  // row i adds to lane (i - begin) % CG_KERNEL_LANES, like the dot kernel
+  int i = begin;
+  for (; i + CG_KERNEL_LANES <= end; i += CG_KERNEL_LANES)
+    for (int j = 0; j < CG_KERNEL_LANES; j++)
+    {
+      int row = i + j;
+      float neighborSum = 0.0f;
+      for (int s = 0; s < slots; s++)
+        neighborSum += u[columns[s * rows + row]] * values[s * rows + row];
+      w[row] = neighborSum + u[row] * diagonal[row];
+      gammas[j] += r[row] * u[row];
+      deltas[j] += w[row] * u[row];
+    }
+
+  *gamma = reduceLanes(gammas);
+  *delta = reduceLanes(deltas);
+  for (; i < end; i++)
+  {
+    float neighborSum = 0.0f;
+    for (int s = 0; s < slots; s++)
+      neighborSum += u[columns[s * rows + i]] * values[s * rows + i];
+    w[i] = neighborSum + u[i] * diagonal[i];
+    *gamma += r[i] * u[i];
+    *delta += w[i] * u[i];
+  }
+}
+
+static void powerScalar(const float* x, float exponent, float* y, int size)
+{
+  for (int i = 0; i < size; i++)
+    y[i] = powerLane(x[i], exponent);
+}
+
+const CG_KERNELS* scalarKernels()
+{
+  static const CG_KERNELS kernels = {
+    "scalar", dotScalar, saxpyScalar, saypxScalar, maxScalar, multiplyScalar,
+    updateScalar, multiplyDotScalar, powerScalar
+  };
+  return &kernels;
+}
+
+//////////////////////////////////////////////////////////////////////
+// check if the CPU and OS support a vector instruction set
+//////////////////////////////////////////////////////////////////////
+static bool cpuSupports(const CG_KERNELS* kernels)
+{
+  if (kernels == NULL) return false;
+  bool avx512 = (kernels == avx512Kernels());
+  if (!avx512 && kernels != avx2Kernels()) return true;
+
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+
+  // the OS has to save the wide registers too
+  __cpuid(info, 1);
+  if (!(info[2] & (1 << 27))) return false;
+  unsigned __int64 xcr0 = _xgetbv(0);
+
+  __cpuidex(info, 7, 0);
+  if (avx512)
+    return (info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6;
+  return (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+#elif defined(__GNUC__)
+  __builtin_cpu_init();
+  if (avx512)
+    return __builtin_cpu_supports("avx512f");
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+// kernel dispatch
+//////////////////////////////////////////////////////////////////////
+static const CG_KERNELS* selected = NULL;
+
+const CG_KERNELS& CG_KERNELS::current()
+{
+  // pick the widest supported instruction set the first time
+  if (selected == NULL)
+  {
+    if (cpuSupports(avx512Kernels()))
+      selected = avx512Kernels();
+    else if (cpuSupports(avx2Kernels()))
+      selected = avx2Kernels();
+    else
+      selected = scalarKernels();
+  }
+  return *selected;
+}
+
+bool CG_KERNELS::select(const char* name)
+{
+  const CG_KERNELS* all[] = {scalarKernels(), avx2Kernels(), avx512Kernels()};
+  for (int x = 0; x < 3; x++)
+    if (all[x] && strcmp(all[x]->name, name) == 0 && cpuSupports(all[x]))
+    {
+      selected = all[x];
+      return true;
+    }
+  return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// aligned allocation
+//////////////////////////////////////////////////////////////////////
+float* CG_KERNELS::allocate(int size)
+{
+#ifdef _WIN32
+  return (float*)_aligned_malloc(size * sizeof(float), 64);
+#else
+  void* data = NULL;
+  if (posix_memalign(&data, 64, size * sizeof(float)) != 0)
+    return NULL;
+  return (float*)data;
+#endif
+}
+
+void CG_KERNELS::release(float* data)
+{
+#ifdef _WIN32
+  _aligned_free(data);
+#else
+  free(data);
+#endif
+}
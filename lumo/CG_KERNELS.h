@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : CG_KERNELS.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef CG_KERNELS_H
+#define CG_KERNELS_H
+
+#include <cmath>
+#include <cstring>
+
+//////////////////////////////////////////////////////////////////////
+/// \brief Table of vector kernels used by the Poisson solvers and the
+/// candidate sampler.
+///
+/// One table exists per instruction set, and the widest one the CPU
+/// supports is picked at runtime. Every backend accumulates dot
+/// products in the same 16 interleaved partial sums and reduces them
+/// in the same order, so all of them return bit-identical results and
+/// a bolt does not depend on the machine it was simulated on.
+//////////////////////////////////////////////////////////////////////
+struct CG_KERNELS
+{
+  //! name of the instruction set
+  const char* name;
+
+  //! returns transpose(x) * y
+  float (*dot)(const float* x, const float* y, int size);
+
+  //! y = y + a * x
+  void (*saxpy)(float a, const float* x, float* y, int size);
+
+  //! y = x + a * y
+  void (*saypx)(float a, const float* x, float* y, int size);
+
+  //! largest entry of x, or zero if there are no positive entries
+  float (*max)(const float* x, int size);
+
+  /// \brief y = A * x, with the off-diagonals of A in slot-major order
+  ///
+  /// \param rows         number of rows
+  /// \param slots        number of off-diagonals stored per row
+  /// \param columns      column of entry s of row i at [s * rows + i]
+  /// \param values       value of entry s of row i at [s * rows + i]
+  /// \param diagonal     diagonal entries
+  /// \param begin        first row of y to compute
+  /// \param end          one past the last row of y to compute
+  void (*multiply)(int rows, int slots, 
+                   const int* columns, const float* values, const float* diagonal,
+                   const float* x, float* y, int begin, int end);
+
+  /// \brief fused vector updates of Chronopoulos-Gear conjugate gradient
+  ///
+  /// In one sweep, p = u + beta * p, s = w + beta * s, x = x + alpha * p
+  /// and r = r - alpha * s. 'u' may be the same array as 'r'.
+  /// \return largest entry of the new r, or zero if there are no positive entries
+  float (*update)(float alpha, float beta, const float* u, const float* w,
+                  float* p, float* s, float* x, float* r, int size);
+
+  /// \brief w = A * u, fused with the dot products that use w
+  ///
+  /// Takes the same matrix and row range arguments as multiply(). 'u'
+  /// may be the same array as 'r'. Row i adds to lane (i - begin) of the
+  /// dot products.
+  /// \param gamma        returns transpose(r) * u
+  /// \param delta        returns transpose(w) * u
+  void (*multiplyDot)(int rows, int slots, 
+                      const int* columns, const float* values, const float* diagonal,
+                      const float* u, const float* r, float* w, float* gamma, float* delta,
+                      int begin, int end);
+
+  /// \brief y = pow(x, exponent), for dielectric breakdown weights
+  ///
+  /// Entries that aren't positive come out as zero. Accurate to about
+  /// 1e-6 relative error. 'x' may be the same array as 'y'.
+  void (*power)(const float* x, float exponent, float* y, int size);
+
+  //! kernels currently in use
+  static const CG_KERNELS& current();
+
+  /// \brief force the kernels of an instruction set
+  ///
+  /// \param name         "scalar", "avx2" or "avx512"
+  /// \return false if the name is unknown or the CPU can't run it
+  static bool select(const char* name);
+
+  //! allocate an array aligned for the widest vectors
+  static float* allocate(int size);
+
+  //! release an array from allocate()
+  static void release(float* data);
+};
+
+//! number of interleaved partial sums in every dot product
+#define CG_KERNEL_LANES 16
+
+//! reduce the partial sums of a dot product in a fixed order
+inline float reduceLanes(const float* partial)
+{
+  float sum = 0.0f;
+  for (int x = 0; x < CG_KERNEL_LANES; x++)
+    sum += partial[x];
+  return sum;
+}
+
+//! log2(m) = t * P(t * t), with t = (m - 1) / (m + 1) and m in [1,2)
+static const float powerLogCoefficients[6] = {
+  2.88539008f, 0.961796694f, 0.577078016f, 0.412198583f, 0.320598898f, 0.262308189f
+};
+
+//! 2^f = Q(f), with f in [-0.5,0.5]
+static const float powerExpCoefficients[7] = {
+  1.0f, 0.693147181f, 0.240226507f, 0.0555041087f, 0.00961812911f, 0.00133335581f, 0.000154035304f
+};
+
+/// \brief one entry of the power() kernel
+///
+/// Every backend does exactly these operations in this order, with
+/// the vector backends using this for their leftover entries.
+inline float powerLane(float x, float exponent)
+{
+  // zero, negative, denormal and NaN entries get no weight
+  if (!(x >= 1.17549435e-38f)) return 0.0f;
+
+  // x = m * 2^k, with m in [1,2)
+  int bits;
+  memcpy(&bits, &x, sizeof(float));
+  float k = (float)((bits >> 23) - 127);
+  bits = (bits & 0x007fffff) | 0x3f800000;
+  float m;
+  memcpy(&m, &bits, sizeof(float));
+
+  float t = (m - 1.0f) / (m + 1.0f);
+  float t2 = t * t;
+  float p = powerLogCoefficients[5];
+  for (int j = 4; j >= 0; j--)
+    p = p * t2 + powerLogCoefficients[j];
+  float y = exponent * (k + t * p);
+
+  // 2^y = 2^n * 2^f, with n an integer and f in [-0.5,0.5]
+  y = (y > -126.0f) ? y : -126.0f;
+  y = (y < 126.0f) ? y : 126.0f;
+  float n = floorf(y + 0.5f);
+  float f = y - n;
+  float q = powerExpCoefficients[6];
+  for (int j = 5; j >= 0; j--)
+    q = q * f + powerExpCoefficients[j];
+
+  bits = ((int)n + 127) << 23;
+  float scale;
+  memcpy(&scale, &bits, sizeof(float));
+  return q * scale;
+}
+
+//! kernel tables of each instruction set, NULL if not compiled in
+const CG_KERNELS* scalarKernels();
+const CG_KERNELS* avx2Kernels();
+const CG_KERNELS* avx512Kernels();
+
+#endif
@@ -0,0 +1,313 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : CG_KERNELS_AVX2.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "CG_KERNELS.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+
+// compile just these functions for AVX2, so the rest of the
+// program still runs on any x86 CPU
+#if defined(__GNUC__)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+// keep every multiply and add separately rounded, or the backends
+// would stop agreeing with each other
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// 256 bit kernels
+//////////////////////////////////////////////////////////////////////
+AVX2_TARGET static float dotAVX2(const float* x, const float* y, int size)
+{
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + CG_KERNEL_LANES <= size; i += CG_KERNEL_LANES)
+  {
+    sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+  }
+
+  float partial[CG_KERNEL_LANES];
+  _mm256_storeu_ps(partial, sum0);
+  _mm256_storeu_ps(partial + 8, sum1);
+
+  float sum = reduceLanes(partial);
+  for (; i < size; i++)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+AVX2_TARGET static void saxpyAVX2(float a, const float* x, float* y, int size)
+{
+  __m256 aa = _mm256_set1_ps(a);
+  int i = 0;
+  for (; i + 8 <= size; i += 8)
+    _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(aa, _mm256_loadu_ps(x + i))));
+  for (; i < size; i++)
+    y[i] += a * x[i];
+}
+
+AVX2_TARGET static void saypxAVX2(float a, const float* x, float* y, int size)
+{
+  __m256 aa = _mm256_set1_ps(a);
+  int i = 0;
+  for (; i + 8 <= size; i += 8)
+    _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(aa, _mm256_loadu_ps(y + i))));
+  for (; i < size; i++)
+    y[i] = x[i] + a * y[i];
+}
+
+AVX2_TARGET static float maxAVX2(const float* x, int size)
+{
+  // the running max goes second so NaNs are skipped like the scalar version
+  __m256 maxes = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= size; i += 8)
+    maxes = _mm256_max_ps(_mm256_loadu_ps(x + i), maxes);
+
+  float partial[8];
+  _mm256_storeu_ps(partial, maxes);
+  float maxX = 0.0f;
+  for (int j = 0; j < 8; j++)
+    maxX = (partial[j] > maxX) ? partial[j] : maxX;
+  for (; i < size; i++)
+    maxX = (x[i] > maxX) ? x[i] : maxX;
+  return maxX;
+}
+
+AVX2_TARGET static void multiplyAVX2(int rows, int slots, 
+                              const int* columns, const float* values, const float* diagonal,
+                              const float* x, float* y, int begin, int end)
+{
+  // 8 rows at a time, gathering one slot of each per step
+  int i = begin;
+  for (; i + 8 <= end; i += 8)
+  {
+    __m256 neighborSum = _mm256_setzero_ps();
+    for (int s = 0; s < slots; s++)
+    {
+      __m256i index = _mm256_loadu_si256((const __m256i*)(columns + s * rows + i));
+      __m256 neighbors = _mm256_i32gather_ps(x, index, 4);
+      neighborSum = _mm256_add_ps(neighborSum, _mm256_mul_ps(neighbors, _mm256_loadu_ps(values + s * rows + i)));
+    }
+    __m256 center = _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(diagonal + i));
+    _mm256_storeu_ps(y + i, _mm256_add_ps(neighborSum, center));
+  }
+
+  for (; i < end; i++)
+  {
+    float neighborSum = 0.0f;
+    for (int s = 0; s < slots; s++)
+      neighborSum += x[columns[s * rows + i]] * values[s * rows + i];
+    y[i] = neighborSum + x[i] * diagonal[i];
+  }
+}
+
+AVX2_TARGET static float updateAVX2(float alpha, float beta, const float* u, const float* w,
+                             float* p, float* s, float* x, float* r, int size)
+{
+  __m256 aa = _mm256_set1_ps(alpha);
+  __m256 bb = _mm256_set1_ps(beta);
+  __m256 maxes = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= size; i += 8)
+  {
+    __m256 pp = _mm256_add_ps(_mm256_loadu_ps(u + i), _mm256_mul_ps(bb, _mm256_loadu_ps(p + i)));
+    __m256 ss = _mm256_add_ps(_mm256_loadu_ps(w + i), _mm256_mul_ps(bb, _mm256_loadu_ps(s + i)));
+    __m256 rr = _mm256_sub_ps(_mm256_loadu_ps(r + i), _mm256_mul_ps(aa, ss));
+    _mm256_storeu_ps(p + i, pp);
+    _mm256_storeu_ps(s + i, ss);
+    _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(aa, pp)));
+    _mm256_storeu_ps(r + i, rr);
+    maxes = _mm256_max_ps(rr, maxes);
+  }
+
+  float partial[8];
+  _mm256_storeu_ps(partial, maxes);
+  float maxR = 0.0f;
+  for (int j = 0; j < 8; j++)
+    maxR = (partial[j] > maxR) ? partial[j] : maxR;
+  for (; i < size; i++)
+  {
+    p[i] = u[i] + beta * p[i];
+    s[i] = w[i] + beta * s[i];
+    x[i] += alpha * p[i];
+    r[i] -= alpha * s[i];
+    maxR = (r[i] > maxR) ? r[i] : maxR;
+  }
+  return maxR;
+}
+
+AVX2_TARGET static void multiplyDotAVX2(int rows, int slots, 
+                                 const int* columns, const float* values, const float* diagonal,
+                                 const float* u, const float* r, float* w, float* gamma, float* delta,
+                                 int begin, int end)
+{
+  // two groups of 8 rows fill the 16 lanes
+  __m256 gammas[2] = {_mm256_setzero_ps(), _mm256_setzero_ps()};
+  __m256 deltas[2] = {_mm256_setzero_ps(), _mm256_setzero_ps()};
+  int i = begin;
+  for (; i + CG_KERNEL_LANES <= end; i += CG_KERNEL_LANES)
+    for (int h = 0; h < 2; h++)
+    {
+      int row = i + 8 * h;
+      __m256 neighborSum = _mm256_setzero_ps();
+      for (int s = 0; s < slots; s++)
+      {
+        __m256i index = _mm256_loadu_si256((const __m256i*)(columns + s * rows + row));
+        __m256 neighbors = _mm256_i32gather_ps(u, index, 4);
+        neighborSum = _mm256_add_ps(neighborSum, _mm256_mul_ps(neighbors, _mm256_loadu_ps(values + s * rows + row)));
+      }
+      __m256 uu = _mm256_loadu_ps(u + row);
+      __m256 ww = _mm256_add_ps(neighborSum, _mm256_mul_ps(uu, _mm256_loadu_ps(diagonal + row)));
+      _mm256_storeu_ps(w + row, ww);
+      gammas[h] = _mm256_add_ps(gammas[h], _mm256_mul_ps(_mm256_loadu_ps(r + row), uu));
+      deltas[h] = _mm256_add_ps(deltas[h], _mm256_mul_ps(ww, uu));
+    }
+
+  float gammaLanes[CG_KERNEL_LANES];
+  float deltaLanes[CG_KERNEL_LANES];
+  _mm256_storeu_ps(gammaLanes, gammas[0]);
+  _mm256_storeu_ps(gammaLanes + 8, gammas[1]);
+  _mm256_storeu_ps(deltaLanes, deltas[0]);
+  _mm256_storeu_ps(deltaLanes + 8, deltas[1]);
+  *gamma = reduceLanes(gammaLanes);
+  *delta = reduceLanes(deltaLanes);
+  for (; i < end; i++)
+  {
+    float neighborSum = 0.0f;
+    for (int s = 0; s < slots; s++)
+      neighborSum += u[columns[s * rows + i]] * values[s * rows + i];
+    w[i] = neighborSum + u[i] * diagonal[i];
+    *gamma += r[i] * u[i];
+    *delta += w[i] * u[i];
+  }
+}
+
+AVX2_TARGET static void powerAVX2(const float* x, float exponent, float* y, int size)
+{
+  // the same steps as powerLane(), 8 entries at a time
+  __m256 ee = _mm256_set1_ps(exponent);
+  __m256 one = _mm256_set1_ps(1.0f);
+  int i = 0;
+  for (; i + 8 <= size; i += 8)
+  {
+    __m256 xx = _mm256_loadu_ps(x + i);
+    __m256 valid = _mm256_cmp_ps(xx, _mm256_set1_ps(1.17549435e-38f), _CMP_GE_OQ);
+
+    __m256i bits = _mm256_castps_si256(xx);
+    __m256 k = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000));
+    __m256 m = _mm256_castsi256_ps(bits);
+
+    __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+    __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_set1_ps(powerLogCoefficients[5]);
+    for (int j = 4; j >= 0; j--)
+      p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(powerLogCoefficients[j]));
+    __m256 yy = _mm256_mul_ps(ee, _mm256_add_ps(k, _mm256_mul_ps(t, p)));
+
+    yy = _mm256_max_ps(yy, _mm256_set1_ps(-126.0f));
+    yy = _mm256_min_ps(yy, _mm256_set1_ps(126.0f));
+    __m256 n = _mm256_floor_ps(_mm256_add_ps(yy, _mm256_set1_ps(0.5f)));
+    __m256 f = _mm256_sub_ps(yy, n);
+    __m256 q = _mm256_set1_ps(powerExpCoefficients[6]);
+    for (int j = 5; j >= 0; j--)
+      q = _mm256_add_ps(_mm256_mul_ps(q, f), _mm256_set1_ps(powerExpCoefficients[j]));
+
+    __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+    __m256 result = _mm256_mul_ps(q, _mm256_castsi256_ps(scale));
+    _mm256_storeu_ps(y + i, _mm256_and_ps(result, valid));
+  }
+
+  for (; i < size; i++)
+    y[i] = powerLane(x[i], exponent);
+}
+
+const CG_KERNELS* avx2Kernels()
+{
+  static const CG_KERNELS kernels = {
+    "avx2", dotAVX2, saxpyAVX2, saypxAVX2, maxAVX2, multiplyAVX2,
+    updateAVX2, multiplyDotAVX2, powerAVX2
+  };
+  return &kernels;
+}
+
+#else
+
+// not an x86 build
+const CG_KERNELS* avx2Kernels()
+{
+  return NULL;
+}
+
+#endif
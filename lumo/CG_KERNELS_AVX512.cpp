@@ -0,0 +1,313 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : CG_KERNELS_AVX512.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "CG_KERNELS.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+// GCC 12 warns that the undefined vectors some AVX512 intrinsics start
+// from may be used uninitialized. That's inside the header and harmless.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// compile just these functions for AVX512, so the rest of the
+// program still runs on any x86 CPU
+#if defined(__GNUC__)
+#define AVX512_TARGET __attribute__((target("avx512f")))
+#else
+#define AVX512_TARGET
+#endif
+
+// keep every multiply and add separately rounded, or the backends
+// would stop agreeing with each other
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// 512 bit kernels
+//////////////////////////////////////////////////////////////////////
+AVX512_TARGET static float dotAVX512(const float* x, const float* y, int size)
+{
+  __m512 sums = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + CG_KERNEL_LANES <= size; i += CG_KERNEL_LANES)
+    sums = _mm512_add_ps(sums, _mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+
+  float partial[CG_KERNEL_LANES];
+  _mm512_storeu_ps(partial, sums);
+
+  float sum = reduceLanes(partial);
+  for (; i < size; i++)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+AVX512_TARGET static void saxpyAVX512(float a, const float* x, float* y, int size)
+{
+  __m512 aa = _mm512_set1_ps(a);
+  int i = 0;
+  for (; i + 16 <= size; i += 16)
+    _mm512_storeu_ps(y + i, _mm512_add_ps(_mm512_loadu_ps(y + i), _mm512_mul_ps(aa, _mm512_loadu_ps(x + i))));
+  for (; i < size; i++)
+    y[i] += a * x[i];
+}
+
+AVX512_TARGET static void saypxAVX512(float a, const float* x, float* y, int size)
+{
+  __m512 aa = _mm512_set1_ps(a);
+  int i = 0;
+  for (; i + 16 <= size; i += 16)
+    _mm512_storeu_ps(y + i, _mm512_add_ps(_mm512_loadu_ps(x + i), _mm512_mul_ps(aa, _mm512_loadu_ps(y + i))));
+  for (; i < size; i++)
+    y[i] = x[i] + a * y[i];
+}
+
+AVX512_TARGET static float maxAVX512(const float* x, int size)
+{
+  // the running max goes second so NaNs are skipped like the scalar version
+  __m512 maxes = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= size; i += 16)
+    maxes = _mm512_max_ps(_mm512_loadu_ps(x + i), maxes);
+
+  float partial[16];
+  _mm512_storeu_ps(partial, maxes);
+  float maxX = 0.0f;
+  for (int j = 0; j < 16; j++)
+    maxX = (partial[j] > maxX) ? partial[j] : maxX;
+  for (; i < size; i++)
+    maxX = (x[i] > maxX) ? x[i] : maxX;
+  return maxX;
+}
+
+AVX512_TARGET static void multiplyAVX512(int rows, int slots, 
+                              const int* columns, const float* values, const float* diagonal,
+                              const float* x, float* y, int begin, int end)
+{
+  // 16 rows at a time, gathering one slot of each per step
+  int i = begin;
+  for (; i + 16 <= end; i += 16)
+  {
+    __m512 neighborSum = _mm512_setzero_ps();
+    for (int s = 0; s < slots; s++)
+    {
+      __m512i index = _mm512_loadu_si512((const void*)(columns + s * rows + i));
+      __m512 neighbors = _mm512_i32gather_ps(index, x, 4);
+      neighborSum = _mm512_add_ps(neighborSum, _mm512_mul_ps(neighbors, _mm512_loadu_ps(values + s * rows + i)));
+    }
+    __m512 center = _mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(diagonal + i));
+    _mm512_storeu_ps(y + i, _mm512_add_ps(neighborSum, center));
+  }
+
+  for (; i < end; i++)
+  {
+    float neighborSum = 0.0f;
+    for (int s = 0; s < slots; s++)
+      neighborSum += x[columns[s * rows + i]] * values[s * rows + i];
+    y[i] = neighborSum + x[i] * diagonal[i];
+  }
+}
+
+AVX512_TARGET static float updateAVX512(float alpha, float beta, const float* u, const float* w,
+                             float* p, float* s, float* x, float* r, int size)
+{
+  __m512 aa = _mm512_set1_ps(alpha);
+  __m512 bb = _mm512_set1_ps(beta);
+  __m512 maxes = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= size; i += 16)
+  {
+    __m512 pp = _mm512_add_ps(_mm512_loadu_ps(u + i), _mm512_mul_ps(bb, _mm512_loadu_ps(p + i)));
+    __m512 ss = _mm512_add_ps(_mm512_loadu_ps(w + i), _mm512_mul_ps(bb, _mm512_loadu_ps(s + i)));
+    __m512 rr = _mm512_sub_ps(_mm512_loadu_ps(r + i), _mm512_mul_ps(aa, ss));
+    _mm512_storeu_ps(p + i, pp);
+    _mm512_storeu_ps(s + i, ss);
+    _mm512_storeu_ps(x + i, _mm512_add_ps(_mm512_loadu_ps(x + i), _mm512_mul_ps(aa, pp)));
+    _mm512_storeu_ps(r + i, rr);
+    maxes = _mm512_max_ps(rr, maxes);
+  }
+
+  float partial[16];
+  _mm512_storeu_ps(partial, maxes);
+  float maxR = 0.0f;
+  for (int j = 0; j < 16; j++)
+    maxR = (partial[j] > maxR) ? partial[j] : maxR;
+  for (; i < size; i++)
+  {
+    p[i] = u[i] + beta * p[i];
+    s[i] = w[i] + beta * s[i];
+    x[i] += alpha * p[i];
+    r[i] -= alpha * s[i];
+    maxR = (r[i] > maxR) ? r[i] : maxR;
+  }
+  return maxR;
+}
+
+AVX512_TARGET static void multiplyDotAVX512(int rows, int slots, 
+                                 const int* columns, const float* values, const float* diagonal,
+                                 const float* u, const float* r, float* w, float* gamma, float* delta,
+                                 int begin, int end)
+{
+  __m512 gammas = _mm512_setzero_ps();
+  __m512 deltas = _mm512_setzero_ps();
+  int i = begin;
+  for (; i + CG_KERNEL_LANES <= end; i += CG_KERNEL_LANES)
+  {
+    int row = i;
+    __m512 neighborSum = _mm512_setzero_ps();
+    for (int s = 0; s < slots; s++)
+    {
+      __m512i index = _mm512_loadu_si512((const void*)(columns + s * rows + row));
+      __m512 neighbors = _mm512_i32gather_ps(index, u, 4);
+      neighborSum = _mm512_add_ps(neighborSum, _mm512_mul_ps(neighbors, _mm512_loadu_ps(values + s * rows + row)));
+    }
+    __m512 uu = _mm512_loadu_ps(u + row);
+    __m512 ww = _mm512_add_ps(neighborSum, _mm512_mul_ps(uu, _mm512_loadu_ps(diagonal + row)));
+    _mm512_storeu_ps(w + row, ww);
+    gammas = _mm512_add_ps(gammas, _mm512_mul_ps(_mm512_loadu_ps(r + row), uu));
+    deltas = _mm512_add_ps(deltas, _mm512_mul_ps(ww, uu));
+  }
+
+  float gammaLanes[CG_KERNEL_LANES];
+  float deltaLanes[CG_KERNEL_LANES];
+  _mm512_storeu_ps(gammaLanes, gammas);
+  _mm512_storeu_ps(deltaLanes, deltas);
+  *gamma = reduceLanes(gammaLanes);
+  *delta = reduceLanes(deltaLanes);
+  for (; i < end; i++)
+  {
+    float neighborSum = 0.0f;
+    for (int s = 0; s < slots; s++)
+      neighborSum += u[columns[s * rows + i]] * values[s * rows + i];
+    w[i] = neighborSum + u[i] * diagonal[i];
+    *gamma += r[i] * u[i];
+    *delta += w[i] * u[i];
+  }
+}
+
+AVX512_TARGET static void powerAVX512(const float* x, float exponent, float* y, int size)
+{
+  // the same steps as powerLane(), 16 entries at a time
+  __m512 ee = _mm512_set1_ps(exponent);
+  __m512 one = _mm512_set1_ps(1.0f);
+  int i = 0;
+  for (; i + 16 <= size; i += 16)
+  {
+    __m512 xx = _mm512_loadu_ps(x + i);
+    __mmask16 valid = _mm512_cmp_ps_mask(xx, _mm512_set1_ps(1.17549435e-38f), _CMP_GE_OQ);
+
+    __m512i bits = _mm512_castps_si512(xx);
+    __m512 k = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(127)));
+    bits = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)), _mm512_set1_epi32(0x3f800000));
+    __m512 m = _mm512_castsi512_ps(bits);
+
+    __m512 t = _mm512_div_ps(_mm512_sub_ps(m, one), _mm512_add_ps(m, one));
+    __m512 t2 = _mm512_mul_ps(t, t);
+    __m512 p = _mm512_set1_ps(powerLogCoefficients[5]);
+    for (int j = 4; j >= 0; j--)
+      p = _mm512_add_ps(_mm512_mul_ps(p, t2), _mm512_set1_ps(powerLogCoefficients[j]));
+    __m512 yy = _mm512_mul_ps(ee, _mm512_add_ps(k, _mm512_mul_ps(t, p)));
+
+    yy = _mm512_max_ps(yy, _mm512_set1_ps(-126.0f));
+    yy = _mm512_min_ps(yy, _mm512_set1_ps(126.0f));
+    __m512 n = _mm512_roundscale_ps(_mm512_add_ps(yy, _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    __m512 f = _mm512_sub_ps(yy, n);
+    __m512 q = _mm512_set1_ps(powerExpCoefficients[6]);
+    for (int j = 5; j >= 0; j--)
+      q = _mm512_add_ps(_mm512_mul_ps(q, f), _mm512_set1_ps(powerExpCoefficients[j]));
+
+    __m512i scale = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(n), _mm512_set1_epi32(127)), 23);
+    __m512 result = _mm512_mul_ps(q, _mm512_castsi512_ps(scale));
+    _mm512_storeu_ps(y + i, _mm512_maskz_mov_ps(valid, result));
+  }
+
+  for (; i < size; i++)
+    y[i] = powerLane(x[i], exponent);
+}
+
+const CG_KERNELS* avx512Kernels()
+{
+  static const CG_KERNELS kernels = {
+    "avx512", dotAVX512, saxpyAVX512, saypxAVX512, maxAVX512, multiplyAVX512,
+    updateAVX512, multiplyDotAVX512, powerAVX512
+  };
+  return &kernels;
+}
+
+#else
+
+// not an x86 build
+const CG_KERNELS* avx512Kernels()
+{
+  return NULL;
+}
+
+#endif
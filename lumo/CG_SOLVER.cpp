@@ -69,24 +69,37 @@
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-CG_SOLVER::CG_SOLVER(int maxDepth, int iterations, int digits) :
-  _iterations(iterations), 
-  _arraySize(0), _listSize(0), _digits(digits),
-  _direction(NULL), _residual(NULL), _q(NULL), _potential(NULL)
+CG_SOLVER::CG_SOLVER(int iterations, int digits) :
+  _iterations(iterations), _digits(digits),
+  _preconditioner(NO_PRECONDITIONER),
+  _direction(NULL), _potential(NULL), _residual(NULL), _q(NULL), _s(NULL),
+  _z(NULL), _invDiagonal(NULL), _arraySize(0), _listSize(0),
+  _pool(new THREAD_POOL())
 {
-  // compute the physical size of various grid cells
-  _dx = new float[maxDepth + 1];
-  _dx[0] = 1.0f;
-  for (int x = 1; x <= maxDepth; x++)
-    _dx[x] = _dx[x - 1] * 0.5f;
 }
 
 CG_SOLVER::~CG_SOLVER()
 {
-  if (_direction) delete[] _direction;
-  if (_residual) delete[] _residual;
-  if (_potential) delete[] _potential;
-  if (_q) delete[] _q;
+  if (_direction) CG_KERNELS::release(_direction);
+  if (_residual) CG_KERNELS::release(_residual);
+  if (_potential) CG_KERNELS::release(_potential);
+  if (_q) CG_KERNELS::release(_q);
+  if (_s) CG_KERNELS::release(_s);
+  if (_z) CG_KERNELS::release(_z);
+  if (_invDiagonal) CG_KERNELS::release(_invDiagonal);
+  delete _pool;
+}
+
+//////////////////////////////////////////////////////////////////////
+// set the number of threads for the vector sweeps
+//////////////////////////////////////////////////////////////////////
+void CG_SOLVER::setThreads(int threads)
+{
+  if (threads < 1) threads = 1;
+  if (threads == _pool->threads()) return;
+
+  delete _pool;
+  _pool = new THREAD_POOL(threads);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -97,152 +110,261 @@ void CG_SOLVER::reallocate()
   // if we have enough size already, return
   if (_arraySize >= _listSize) return;
 
-  // made sure it SSE aligns okay
+  // pad to a whole number of the widest vectors
   _arraySize = _listSize * 2;
-  if (_arraySize % 4)
-    _arraySize += 4 - _arraySize % 4;
+  if (_arraySize % 16)
+    _arraySize += 16 - _arraySize % 16;
  
   // delete the old ones
-  if (_direction) delete[] _direction;
-  if (_residual) delete[] _residual;
-  if (_q) delete[] _q;
+  if (_direction) CG_KERNELS::release(_direction);
+  if (_residual) CG_KERNELS::release(_residual);
+  if (_potential) CG_KERNELS::release(_potential);
+  if (_q) CG_KERNELS::release(_q);
+  if (_s) CG_KERNELS::release(_s);
+  if (_z) CG_KERNELS::release(_z);
+  if (_invDiagonal) CG_KERNELS::release(_invDiagonal);
 
   // allocate the new ones
-  _direction = new float[_arraySize];
-  _residual = new float[_arraySize];
-  _q = new float[_arraySize];
+  _direction = CG_KERNELS::allocate(_arraySize);
+  _residual = CG_KERNELS::allocate(_arraySize);
+  _potential = CG_KERNELS::allocate(_arraySize);
+  _q = CG_KERNELS::allocate(_arraySize);
+  _s = CG_KERNELS::allocate(_arraySize);
+  _z = CG_KERNELS::allocate(_arraySize);
+  _invDiagonal = CG_KERNELS::allocate(_arraySize);
 
   // wipe the new ones
   for (int x = 0; x < _arraySize; x++)
-    _direction[x] = _residual[x] = _q[x] = 0.0f;
+    _direction[x] = _residual[x] = _potential[x] = _q[x] = _s[x] = _z[x] = _invDiagonal[x] = 0.0f;
 }
 
 //////////////////////////////////////////////////////////////////////
-// conjugate gradient solver
+// assemble the stencils into flat arrays
 //////////////////////////////////////////////////////////////////////
-int CG_SOLVER::solve(list<CELL*> cells)
+void CG_SOLVER::assemble(vector<CELL*>& cells, vector<CELL*>* changed)
 {
-  // counters
-  int x, y, index;
-  list<CELL*>::iterator cellIterator;
+  // build the flat system
+  _system.build(cells, changed);
+ 
+  // reallocate scratch arrays if necessary
+  _listSize = _system.rows;
+  reallocate();
+}
 
+//////////////////////////////////////////////////////////////////////
+// conjugate gradient solver
+//////////////////////////////////////////////////////////////////////
+int CG_SOLVER::solve(vector<CELL*>& cells, vector<CELL*>* changed)
+{
   // i = 0
   int i = 0;
 
-  // precalculate stencils
-  calcStencils(cells);
- 
-  // reallocate scratch arrays if necessary
-  _listSize = cells.size();
-  reallocate();
- 
-  // compute a new lexicographical order
-  cellIterator = cells.begin();
-  for (x = 0; x < _listSize; x++, cellIterator++)
-    (*cellIterator)->index = x;
+  // assemble the system once, everything after this
+  // only touches flat arrays
+  assemble(cells, changed);
+  _system.gather(_potential);
   
   // r = b - Ax
-  calcResidual(cells);
+  calcResidual();
 
-  // copy residual into easy array
-  // d = r
-  cellIterator = cells.begin();
-  float deltaNew = 0.0f;
-  for (x = 0; x < _listSize; x++, cellIterator++)
+  // u = inverse(M) * r, which is just r without a preconditioner
+  float* u = _residual;
+  if (_preconditioner != NO_PRECONDITIONER)
   {
-    _direction[x] = _residual[x];
-    deltaNew += _residual[x] * _residual[x];
+    u = _z;
+    factor();
+    precondition();
   }
 
-  // delta0 = deltaNew
-  float delta0 = deltaNew;
+  // w = Au, gamma = transpose(r) * u, delta = transpose(w) * u
+  float gamma, delta;
+  multiplyDot(u, _q, &gamma, &delta);
+  float alpha = (fabs(delta) > 0.0f) ? gamma / delta : 0.0f;
+  float beta = 0.0f;
  
-  // While deltaNew > (eps^2) * delta0
+  // Chronopoulos-Gear conjugate gradient, which computes both dot
+  // products of an iteration next to each other so that they fuse
+  // with the matrix multiply, and the vector updates fuse into one
+  // more sweep
   float eps  = pow(10.0f, (float)-_digits);
-  float maxR = 2.0f * eps;
+  float maxR = (gamma > 0.0f) ? 2.0f * eps : 0.0f;
   while ((i < _iterations) && (maxR > eps))
   {
-    // q = Ad
-    cellIterator = cells.begin();
-    for (y = 0; y < _listSize; y++, cellIterator++)
-    {
-      CELL* currentCell = *cellIterator;
-      CELL** neighbors = currentCell->neighbors;
-
-      float neighborSum = 0.0f;
-      for (int x = 0; x < 4; x++)
-      {
-        int j = x * 2;
-        neighborSum += _direction[neighbors[j]->index] * currentCell->stencil[j];
-        if (neighbors[j+1])
-          neighborSum += _direction[neighbors[j+1]->index] * currentCell->stencil[j+1];
-      }
-      _q[y] = -neighborSum + _direction[y] * currentCell->stencil[8];
-    }
-    // alpha = deltaNew / (transpose(d) * q)
-    float alpha = 0.0f;
-    for (x = 0; x < _listSize; x++)
-      alpha += _direction[x] * _q[x];
-    if (fabs(alpha) > 0.0f)
-      alpha = deltaNew / alpha;
+    // d = u + beta * d, s = w + beta * s
+    // x = x + alpha * d, r = r - alpha * s
+    maxR = update(alpha, beta, u);
 
-    // x = x + alpha * d
-    cellIterator = cells.begin();
-    for (x = 0; x < _listSize; x++, cellIterator++)
-      (*cellIterator)->potential += alpha * _direction[x];
+    // u = inverse(M) * r
+    if (_preconditioner != NO_PRECONDITIONER)
+      precondition();
 
-    // r = r - alpha * q
-    maxR = 0.0f;
-    for (x = 0; x < _listSize; x++)
+    // w = Au, and the new gamma and delta
+    float gammaOld = gamma;
+    multiplyDot(u, _q, &gamma, &delta);
+
+    // i = i + 1
+    i++;
+
+    // the residual vanished
+    if (gamma <= 0.0f)
+      break;
+
+    beta = gamma / gammaOld;
+    float denominator = delta - beta * gamma / alpha;
+    alpha = (fabs(denominator) > 0.0f) ? gamma / denominator : 0.0f;
+  }
+
+  // copy the solution back into the tree
+  _system.scatter(_potential);
+
+  return i;
+}
+
+//////////////////////////////////////////////////////////////////////
+// w = Au, fused with gamma = transpose(r) * u and delta = transpose(w) * u
+//////////////////////////////////////////////////////////////////////
+void CG_SOLVER::multiplyDot(const float* u, float* w, float* gamma, float* delta)
+{
+  *gamma = *delta = 0.0f;
+  if (_system.rows == 0) return;
+
+  const CG_KERNELS& kernels = CG_KERNELS::current();
+  const int* columns = _system.slotColumns.empty() ? NULL : &_system.slotColumns[0];
+  const float* values = _system.slotValues.empty() ? NULL : &_system.slotValues[0];
+  const float* diagonal = &_system.diagonal[0];
+
+  // each block writes its own pair of partial sums
+  int totalBlocks = blocks();
+  _partials.resize(2 * totalBlocks);
+  float* partials = &_partials[0];
+  _pool->run(totalBlocks, [&](int block) {
+    int begin = block * CG_BLOCK_ROWS;
+    int end = (begin + CG_BLOCK_ROWS < _listSize) ? begin + CG_BLOCK_ROWS : _listSize;
+    kernels.multiplyDot(_system.rows, _system.slots, columns, values, diagonal,
+                        u, _residual, w, &partials[2 * block], &partials[2 * block + 1],
+                        begin, end);
+  });
+
+  // add them up in block order, whichever thread ran them
+  for (int x = 0; x < totalBlocks; x++)
+  {
+    *gamma += partials[2 * x];
+    *delta += partials[2 * x + 1];
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// d = u + beta * d, s = w + beta * s, x = x + alpha * d, r = r - alpha * s
+//////////////////////////////////////////////////////////////////////
+float CG_SOLVER::update(float alpha, float beta, const float* u)
+{
+  const CG_KERNELS& kernels = CG_KERNELS::current();
+
+  int totalBlocks = blocks();
+  _partials.resize(totalBlocks);
+  float* partials = &_partials[0];
+  _pool->run(totalBlocks, [&](int block) {
+    int begin = block * CG_BLOCK_ROWS;
+    int size = (begin + CG_BLOCK_ROWS < _listSize) ? CG_BLOCK_ROWS : _listSize - begin;
+    partials[block] = kernels.update(alpha, beta, u + begin, _q + begin, _direction + begin,
+                                     _s + begin, _potential + begin, _residual + begin, size);
+  });
+
+  float maxR = 0.0f;
+  for (int x = 0; x < totalBlocks; x++)
+    maxR = (partials[x] > maxR) ? partials[x] : maxR;
+  return maxR;
+}
+
+//////////////////////////////////////////////////////////////////////
+// build the preconditioner for the assembled system
+//////////////////////////////////////////////////////////////////////
+void CG_SOLVER::factor()
+{
+  const int* rowStart = &_system.rowStart[0];
+
+  // Jacobi just inverts the diagonal
+  if (_preconditioner != INCOMPLETE_CHOLESKY)
+  {
+    for (int x = 0; x < _listSize; x++)
+      _invDiagonal[x] = 1.0f / _system.diagonal[x];
+    return;
+  }
+
+  // IC(0) in the form M = (D + L) * inverse(D) * transpose(D + L),
+  // where L is the strictly lower part of A and D is picked so that
+  // the diagonals of M and A match
+  for (int y = 0; y < _listSize; y++)
+  {
+    float d = _system.diagonal[y];
+    for (int k = rowStart[y]; k < rowStart[y + 1]; k++)
     {
-      _residual[x] -= _q[x] * alpha;
-      maxR = (_residual[x] > maxR) ? _residual[x] : maxR;
+      int x = _system.columns[k];
+      if (x < y)
+        d -= _system.values[k] * _system.values[k] * _invDiagonal[x];
     }
-    
-    // deltaOld = deltaNew
-    float deltaOld = deltaNew;
 
-    // deltaNew = transpose(r) * r
-    deltaNew = 0.0f;
-    for (x = 0; x < _listSize; x++)
-      deltaNew += _residual[x] * _residual[x];
+    // fall back to Jacobi if the factorization breaks down
+    if (d <= 0.0f)
+      d = _system.diagonal[y];
+    _invDiagonal[y] = 1.0f / d;
+  }
+}
 
-    // beta = deltaNew / deltaOld
-    float beta = deltaNew / deltaOld;
+//////////////////////////////////////////////////////////////////////
+// apply the preconditioner to the residual
+//////////////////////////////////////////////////////////////////////
+void CG_SOLVER::precondition()
+{
+  const int* rowStart = &_system.rowStart[0];
+  int x, y;
 
-    // d = r + beta * d
+  if (_preconditioner != INCOMPLETE_CHOLESKY)
+  {
     for (x = 0; x < _listSize; x++)
-      _direction[x] = _residual[x] + beta * _direction[x];
+      _z[x] = _residual[x] * _invDiagonal[x];
+    return;
+  }
 
-    // i = i + 1
-    i++;
+  // forward substitution, (D + L) * u = r
+  for (y = 0; y < _listSize; y++)
+  {
+    float sum = _residual[y];
+    for (int k = rowStart[y]; k < rowStart[y + 1]; k++)
+    {
+      x = _system.columns[k];
+      if (x < y)
+        sum -= _system.values[k] * _z[x];
+    }
+    _z[y] = sum * _invDiagonal[y];
   }
 
-  return i;
+  // backward substitution, transpose(D + L) * z = D * u
+  for (y = _listSize - 1; y >= 0; y--)
+  {
+    float sum = 0.0f;
+    for (int k = rowStart[y]; k < rowStart[y + 1]; k++)
+    {
+      x = _system.columns[k];
+      if (x > y)
+        sum += _system.values[k] * _z[x];
+    }
+    _z[y] -= sum * _invDiagonal[y];
+  }
 }
 
 //////////////////////////////////////////////////////////////////////
 // calculate the residuals
 //////////////////////////////////////////////////////////////////////
-float CG_SOLVER::calcResidual(list<CELL*> cells)
+float CG_SOLVER::calcResidual()
 {
   float maxResidual = 0.0f;
-  
-  list<CELL*>::iterator cellIterator = cells.begin();
-  for (int i = 0; i < _listSize; i++, cellIterator++)
+
+  // r = b - Ax
+  multiply(_potential, _residual);
+  for (int i = 0; i < _listSize; i++)
   {
-    CELL* currentCell = *cellIterator;
-    float dx = _dx[currentCell->depth];
-    float neighborSum = 0.0f;
-    
-    for (int x = 0; x < 4; x++)
-    {
-      int i = x * 2;
-      neighborSum += currentCell->neighbors[i]->potential * currentCell->stencil[i];
-      if (currentCell->neighbors[i+1])
-        neighborSum += currentCell->neighbors[i+1]->potential * currentCell->stencil[i+1];
-    }
-    _residual[i] = currentCell->b - (-neighborSum + currentCell->potential * currentCell->stencil[8]);
+    _residual[i] = _system.rhs[i] - _residual[i];
     
     if (fabs(_residual[i]) > maxResidual)
       maxResidual = fabs(_residual[i]);
@@ -251,59 +373,20 @@ float CG_SOLVER::calcResidual(list<CELL*> cells)
 }
 
 //////////////////////////////////////////////////////////////////////
-// compute stencils once and store
+// y = Ax with the assembled system
 //////////////////////////////////////////////////////////////////////
-void CG_SOLVER::calcStencils(list<CELL*> cells)
+void CG_SOLVER::multiply(const float* x, float* y)
 {
-  list<CELL*>::iterator cellIterator = cells.begin();
-  for (cellIterator = cells.begin(); cellIterator != cells.end(); cellIterator++)
-  {
-    CELL* currentCell = *cellIterator;
-    float invDx = 1.0f / _dx[currentCell->depth];
+  if (_system.rows == 0) return;
 
-    // sum over faces
-    float deltaSum = 0.0f;
-    float bSum = 0.0f;
+  const CG_KERNELS& kernels = CG_KERNELS::current();
+  const int* columns = _system.slotColumns.empty() ? NULL : &_system.slotColumns[0];
+  const float* values = _system.slotValues.empty() ? NULL : &_system.slotValues[0];
+  const float* diagonal = &_system.diagonal[0];
 
-    for (int x = 0; x < 4; x++)
-    {
-      int i = x * 2;
-      currentCell->stencil[i] = 0.0f;
-      currentCell->stencil[i+1] = 0.0f;
-      
-      if (currentCell->neighbors[i + 1] == NULL) {
-        // if it is the same refinement level (case 1)
-        if (currentCell->depth == currentCell->neighbors[i]->depth) {
-          deltaSum += invDx;
-          if (!currentCell->neighbors[i]->boundary)
-            currentCell->stencil[i] = invDx;
-          else
-            bSum += (currentCell->neighbors[i]->potential) * invDx;
-        }
-        // else it is less refined (case 3)
-        else {
-          deltaSum += 0.5f * invDx;
-          if (!currentCell->neighbors[i]->boundary)
-            currentCell->stencil[i] = 0.5f * invDx;
-          else
-            bSum += currentCell->neighbors[i]->potential * 0.5f * invDx;
-        }
-      }
-      // if the neighbor is at a lower level (case 2)
-      else {
-        deltaSum += 2.0f * invDx;
-        if (!currentCell->neighbors[i]->boundary)
-          currentCell->stencil[i] = invDx;
-        else
-          bSum += currentCell->neighbors[i]->potential * invDx;
-        if (!currentCell->neighbors[i+1]->boundary)
-          currentCell->stencil[i+1] = invDx;
-        else
-          bSum += currentCell->neighbors[i+1]->potential * invDx;
-      }
-    }
-
-    currentCell->stencil[8] = deltaSum;
-    currentCell->b = bSum;
-  }
+  _pool->run(blocks(), [&](int block) {
+    int begin = block * CG_BLOCK_ROWS;
+    int end = (begin + CG_BLOCK_ROWS < _listSize) ? begin + CG_BLOCK_ROWS : _listSize;
+    kernels.multiply(_system.rows, _system.slots, columns, values, diagonal, x, y, begin, end);
+  });
 }
@@ -67,11 +67,22 @@
 #define CG_SOLVER_H
 
 #include "CELL.h"
+#include "POISSON_SYSTEM.h"
+#include "CG_KERNELS.h"
+#include "THREAD_POOL.h"
 #include <cmath>
-#include <list>
+#include <vector>
 
 using namespace std;
 
+//////////////////////////////////////////////////////////////////////
+/// \enum Preconditioners available to the conjugate gradient solver
+//////////////////////////////////////////////////////////////////////
+enum PRECONDITIONER {NO_PRECONDITIONER, JACOBI, INCOMPLETE_CHOLESKY, MULTIGRID};
+
+//! rows per block of the threaded sweeps, a multiple of CG_KERNEL_LANES
+#define CG_BLOCK_ROWS 2048
+
 ////////////////////////////////////////////////////////////////////
 /// \brief Conjugate gradient Poisson solver.
 ////////////////////////////////////////////////////////////////////
@@ -79,22 +90,45 @@ class CG_SOLVER
 {
 public:
   //! constructor
-	CG_SOLVER(int maxDepth, int iterations = 10, int digits = 8);
+	CG_SOLVER(int iterations = 10, int digits = 8);
   //! destructor
 	virtual ~CG_SOLVER();
 
-  //! solve the Poisson problem
-  virtual int solve(list<CELL*> cells);
+  /// \brief solve the Poisson problem
+  ///
+  /// \param cells        leaves not on the boundary
+  /// \param changed      cells refined or inserted since the last solve,
+  ///                     NULL if anything may have changed
+  virtual int solve(vector<CELL*>& cells, vector<CELL*>* changed = NULL);
 
-  //! calculate the residual
-  float calcResidual(list<CELL*> cells);
+  //! calculate the residual of the assembled system
+  float calcResidual();
 
   //! accessor for the maximum number of iterations
   int& iterations() { return _iterations; };
 
+  /// \brief accessor for the preconditioner
+  ///
+  /// The diagonal scales with 1/dx, so it varies by orders of magnitude
+  /// across depths. Preconditioners are rebuilt on every solve. MULTIGRID
+  /// needs an MG_SOLVER, this class falls back to JACOBI for it.
+  PRECONDITIONER& preconditioner() { return _preconditioner; };
+
+  /// \brief set the number of threads for the vector sweeps
+  ///
+  /// Sweeps are cut into blocks of CG_BLOCK_ROWS rows whatever the
+  /// thread count, and the partial dot products of the blocks are added
+  /// up in block order, so every thread count gives the same bits.
+  /// The preconditioners still run on one thread.
+  void setThreads(int threads);
+
+  //! number of threads running the vector sweeps
+  int threads() { return _pool->threads(); };
+
 protected:  
   int _iterations;  ///< maximum number of iterations
   int _digits;      ///< desired digits of precision
+  PRECONDITIONER _preconditioner; ///< preconditioner to apply
 
   ////////////////////////////////////////////////////////////////
   // conjugate gradient arrays
@@ -102,19 +136,48 @@ protected:
   float* _direction;  ///< conjugate gradient 'd' array
   float* _potential;  ///< conjugate gradient solution, 'x' array
   float* _residual;   ///< conjugate gradient residual, 'r' array
-  float* _q;          ///< conjugate gradient 'q' array
+  float* _q;          ///< conjugate gradient 'w' array, A times 'u'
+  float* _s;          ///< conjugate gradient 's' array, A times 'd'
+  float* _z;          ///< preconditioned residual, 'u' array
+  float* _invDiagonal;///< inverse diagonal of the preconditioner
   
   int _arraySize;     ///< currently allocated array size
   int _listSize;      ///< current system size
 
-  //! compute stencils once and store
-  void calcStencils(list<CELL*> cells);
+  //! the system assembled from the quadtree
+  POISSON_SYSTEM _system;
 
-  //! reallocate the scratch arrays
-  virtual void reallocate();
+  //! threads running the vector sweeps
+  THREAD_POOL* _pool;
+
+  //! per block partial results of the threaded sweeps
+  vector<float> _partials;
+
+  //! number of CG_BLOCK_ROWS blocks in the assembled system
+  int blocks() { return (_listSize + CG_BLOCK_ROWS - 1) / CG_BLOCK_ROWS; };
 
-  //! physical lengths of various cell sizes
-  float* _dx;
+  //! assemble the stencils into the flat system
+  void assemble(vector<CELL*>& cells, vector<CELL*>* changed);
+
+  //! y = Ax with the assembled system
+  void multiply(const float* x, float* y);
+
+  //! w = Au, along with transpose(r) * u and transpose(w) * u
+  void multiplyDot(const float* u, float* w, float* gamma, float* delta);
+
+  /// \brief fused Chronopoulos-Gear vector updates
+  ///
+  /// \return largest entry of the new residual
+  float update(float alpha, float beta, const float* u);
+
+  //! build the preconditioner for the assembled system
+  virtual void factor();
+
+  //! apply the preconditioner, z = inverse(M) * r
+  virtual void precondition();
+
+  //! reallocate the scratch arrays
+  void reallocate();
 };
 
 #endif
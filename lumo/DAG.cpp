@@ -191,6 +191,7 @@ void DAG::buildBranch(NODE* node, int depth)
       buildBranch(node->neighbors[x], depth + 1);
 }
 
+#ifndef NO_OPENGL
 //////////////////////////////////////////////////////////////////////
 // draw the DAG segments
 //////////////////////////////////////////////////////////////////////
@@ -234,6 +235,7 @@ void DAG::drawNode(NODE* root)
       drawNode(endNode);
   }
 }
+#endif
 
 //////////////////////////////////////////////////////////////////////
 // set the intensity of the node
@@ -69,7 +69,9 @@
 #include <map>
 #include <vector>
 #include <cmath>
-#include <gl/glut.h>
+#ifndef NO_OPENGL
+#include <GL/glut.h>
+#endif
 #include <iostream>
 
 using namespace std;
@@ -91,8 +93,10 @@ public:
   //! add DAG segment
   bool addSegment(int index, int neighbor);
 
+#ifndef NO_OPENGL
   //! draw to OpenGL
   void draw() { drawNode(_root); };
+#endif
 
   //! draw to an offscreen buffer
   float*& drawOffscreen(int scale = 1);
@@ -154,8 +158,10 @@ private:
 
   //! build side branch
   void buildBranch(NODE* node, int depth);
+#ifndef NO_OPENGL
   //! draw a node to OpenGL
   void drawNode(NODE* root);
+#endif
   //! find the deepest node in a given subtree
   void findDeepest(NODE* root, NODE*& deepest);
 
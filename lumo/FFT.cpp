@@ -64,72 +64,45 @@
 // 
 
 #include "FFT.h"
+#include <mutex>
+
+// FFTW only allows one thread at a time in its planner
+static mutex plannerMutex;
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-FFT::FFT()
-{
-
-}
-
-FFT::~FFT()
-{
-
-}
-
-bool FFT::convolve(float* source, float* kernel, int xSource, int ySource, int xKernel, int yKernel)
+FFT::FFT(float* kernel, int xKernel, int yKernel, int xSource, int ySource) :
+  _xSource(xSource), _ySource(ySource), _xKernel(xKernel), _yKernel(yKernel),
+  _maxKernel(0.0f), _filterTransformed(NULL), _forward(NULL), _backward(NULL)
 {
   int x, y, index;
   
   // get normalization params
-  float maxCurrent = 0.0f;
-  for (x = 0; x < xSource * ySource; x++)
-    maxCurrent = (maxCurrent < source[x]) ? source[x] : maxCurrent;
-  float maxKernel = 0.0f;
   for (x = 0; x < xKernel * yKernel; x++)
-    maxKernel = (maxKernel < kernel[x]) ? kernel[x] : maxKernel;
-  float maxProduct = maxCurrent * maxKernel;
+    _maxKernel = (_maxKernel < kernel[x]) ? kernel[x] : _maxKernel;
  
   // retrieve dimensions
   int xHalf = xKernel / 2;
   int yHalf = yKernel / 2;
-  int xResPadded = xSource + xKernel;
-  int yResPadded = ySource + yKernel;
+  _xResPadded = xSource + xKernel;
+  _yResPadded = ySource + yKernel;
 
-  if (xResPadded != yResPadded)
-    (xResPadded > yResPadded) ? yResPadded = xResPadded : xResPadded = yResPadded;
-
-  // create padded field
-  fftw_complex* padded = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * xResPadded * yResPadded);
-  if (!padded)
-  {
-    cout << " IMAGE: Not enough memory! Try a smaller final image size." << endl;
-    return false;
-  }
- 
-  // init padded field
-  for (index = 0; index < xResPadded * yResPadded; index++)
-    padded[index][0] = padded[index][1] = 0.0f;
-  index = 0;
-  for (y = 0; y < ySource; y++)
-    for (x = 0; x < xSource; x++, index++)
-    {
-      int paddedIndex = (x + xKernel / 2) + (y + yKernel / 2) * xResPadded;
-      padded[paddedIndex][0] = source[index];
-    }
+  if (_xResPadded != _yResPadded)
+    (_xResPadded > _yResPadded) ? _yResPadded = _xResPadded : _xResPadded = _yResPadded;
+  int size = _xResPadded * _yResPadded;
 
   // create padded filter
-  fftw_complex* filter = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * xResPadded * yResPadded);
+  fftw_complex* filter = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * size);
   if (!filter)
   {
     cout << " FILTER: Not enough memory! Try a smaller final image size." << endl;
-    return false;
+    return;
   }
 
   // init padded filter
-  for (index = 0; index < xResPadded * yResPadded; index++)
+  for (index = 0; index < size; index++)
     filter[index][0] = filter[index][1] = 0.0f;
   
   // quadrant IV
@@ -137,7 +110,7 @@ bool FFT::convolve(float* source, float* kernel, int xSource, int ySource, int x
     for (x = 0; x < (xHalf + 1); x++)
     {
       int filterIndex = x + xHalf + y * xKernel;
-      int fieldIndex = x + (y + yResPadded - (yHalf + 1)) * xResPadded;
+      int fieldIndex = x + (y + _yResPadded - (yHalf + 1)) * _xResPadded;
       filter[fieldIndex][0] = kernel[filterIndex];
     }
 
@@ -146,7 +119,7 @@ bool FFT::convolve(float* source, float* kernel, int xSource, int ySource, int x
     for (x = 0; x < (xHalf + 1); x++)
     {
       int filterIndex = (x + xHalf) + (y + yHalf + 1) * xKernel;
-      int fieldIndex = x + y * xResPadded;
+      int fieldIndex = x + y * _xResPadded;
       filter[fieldIndex][0] = filter[fieldIndex][1] = kernel[filterIndex];
     }
   
@@ -155,7 +128,7 @@ bool FFT::convolve(float* source, float* kernel, int xSource, int ySource, int x
     for (x = 0; x < xHalf; x++)
     {
       int filterIndex = x + y * xKernel;
-      int fieldIndex = (x + xResPadded - xHalf) + (y + yResPadded - (yHalf + 1)) * xResPadded;
+      int fieldIndex = (x + _xResPadded - xHalf) + (y + _yResPadded - (yHalf + 1)) * _xResPadded;
       filter[fieldIndex][0] = filter[fieldIndex][1] = kernel[filterIndex];
     }
 
@@ -164,70 +137,130 @@ bool FFT::convolve(float* source, float* kernel, int xSource, int ySource, int x
     for (x = 0; x < xHalf; x++)
     {
       int filterIndex = x + (y + yHalf + 1) * xKernel;
-      int fieldIndex = (x + xResPadded - xHalf) + y * xResPadded;
+      int fieldIndex = (x + _xResPadded - xHalf) + y * _xResPadded;
       filter[fieldIndex][0] = filter[fieldIndex][1] = kernel[filterIndex];
     }
   
-  // perform forward FFT on field
-  fftw_complex* paddedTransformed = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * xResPadded * yResPadded);
-  if (!paddedTransformed)
+  _filterTransformed = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * size);
+  if (!_filterTransformed)
   {
-    cout << " T-IMAGE: Not enough memory! Try a smaller final image size." << endl;
-    return false;
+    cout << " T-FILTER: Not enough memory! Try a smaller final image size." << endl;
+    fftw_free(filter);
+    return;
+  }
+
+  // plan once, every image after this reuses the plans on its own arrays
+  {
+    lock_guard<mutex> lock(plannerMutex);
+    _forward = fftw_plan_dft_2d(_xResPadded, _yResPadded, filter, _filterTransformed, FFTW_FORWARD, FFTW_ESTIMATE);
+    _backward = fftw_plan_dft_2d(_xResPadded, _yResPadded, _filterTransformed, filter, FFTW_BACKWARD, FFTW_ESTIMATE);
   }
-  fftw_plan forwardField = fftw_plan_dft_2d(xResPadded, yResPadded, padded, paddedTransformed, FFTW_FORWARD, FFTW_ESTIMATE);  
-  fftw_execute(forwardField);
 
   // perform forward FFT on filter
-  fftw_complex* filterTransformed = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * xResPadded * yResPadded);
-  if (!filterTransformed)
+  fftw_execute(_forward);
+  fftw_free(filter);
+}
+
+FFT::~FFT()
+{
+  lock_guard<mutex> lock(plannerMutex);
+  if (_forward) fftw_destroy_plan(_forward);
+  if (_backward) fftw_destroy_plan(_backward);
+  if (_filterTransformed) fftw_free(_filterTransformed);
+}
+
+//////////////////////////////////////////////////////////////////////
+// convolve with the prepared kernel
+//////////////////////////////////////////////////////////////////////
+bool FFT::convolve(float* source) const
+{
+  if (!_filterTransformed)
+    return false;
+
+  int x, y, index;
+  int size = _xResPadded * _yResPadded;
+  
+  // get normalization params
+  float maxCurrent = 0.0f;
+  for (x = 0; x < _xSource * _ySource; x++)
+    maxCurrent = (maxCurrent < source[x]) ? source[x] : maxCurrent;
+  float maxProduct = maxCurrent * _maxKernel;
+
+  // create padded field
+  fftw_complex* padded = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * size);
+  if (!padded)
   {
-    cout << " T-FILTER: Not enough memory! Try a smaller final image size." << endl;
+    cout << " IMAGE: Not enough memory! Try a smaller final image size." << endl;
     return false;
   }
-  fftw_plan forwardFilter = fftw_plan_dft_2d(xResPadded, yResPadded, filter, filterTransformed, FFTW_FORWARD, FFTW_ESTIMATE);  
-  fftw_execute(forwardFilter);
+ 
+  // init padded field
+  for (index = 0; index < size; index++)
+    padded[index][0] = padded[index][1] = 0.0f;
+  index = 0;
+  for (y = 0; y < _ySource; y++)
+    for (x = 0; x < _xSource; x++, index++)
+    {
+      int paddedIndex = (x + _xKernel / 2) + (y + _yKernel / 2) * _xResPadded;
+      padded[paddedIndex][0] = source[index];
+    }
+
+  // perform forward FFT on field
+  fftw_complex* paddedTransformed = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * size);
+  if (!paddedTransformed)
+  {
+    cout << " T-IMAGE: Not enough memory! Try a smaller final image size." << endl;
+    fftw_free(padded);
+    return false;
+  }
+  fftw_execute_dft(_forward, padded, paddedTransformed);
 
   // apply frequency space filter
-  for (index = 0; index < xResPadded * yResPadded; index++)
+  for (index = 0; index < size; index++)
   {
-    float newReal = paddedTransformed[index][0] * filterTransformed[index][0] - 
-                    paddedTransformed[index][1] * filterTransformed[index][1];
-    float newIm   = paddedTransformed[index][0] * filterTransformed[index][1] + 
-                    paddedTransformed[index][1] * filterTransformed[index][0];
+    float newReal = paddedTransformed[index][0] * _filterTransformed[index][0] - 
+                    paddedTransformed[index][1] * _filterTransformed[index][1];
+    float newIm   = paddedTransformed[index][0] * _filterTransformed[index][1] + 
+                    paddedTransformed[index][1] * _filterTransformed[index][0];
     paddedTransformed[index][0] = newReal;
     paddedTransformed[index][1] = newIm;
   }
    
   // transform back
-  fftw_plan backwardField = fftw_plan_dft_2d(xResPadded, yResPadded, paddedTransformed, padded, FFTW_BACKWARD, FFTW_ESTIMATE);  
-  fftw_execute(backwardField);
+  fftw_execute_dft(_backward, paddedTransformed, padded);
   
   // copy back into padded
   index = 0;
-  for (y = 0; y < ySource; y++)
-    for (x = 0; x < xSource; x++, index++)
+  for (y = 0; y < _ySource; y++)
+    for (x = 0; x < _xSource; x++, index++)
     {
-      int paddedIndex = (x + xKernel / 2) + (y + yKernel / 2) * xResPadded;
+      int paddedIndex = (x + _xKernel / 2) + (y + _yKernel / 2) * _xResPadded;
       source[index] = padded[paddedIndex][0];
     }
 
   // clean up
   fftw_free(padded);
   fftw_free(paddedTransformed);
-  fftw_free(filter);
-  fftw_free(filterTransformed);
 
   // if normalization is exceeded, renormalize
   float newMax = 0.0f;
-  for (x = 0; x < xSource * ySource; x++)
+  for (x = 0; x < _xSource * _ySource; x++)
     newMax = (newMax < source[x]) ? source[x] : newMax;
   if (newMax > maxProduct)
   {
     float scale = maxProduct / newMax;
-    for (x = 0; x < xSource * ySource; x++)
+    for (x = 0; x < _xSource * _ySource; x++)
       source[x] *= scale;
   }
 
   return true;
 }
+
+//////////////////////////////////////////////////////////////////////
+// convolve a single image
+//////////////////////////////////////////////////////////////////////
+bool FFT::convolve(float* source, float* kernel, int xSource, int ySource, int xKernel, int yKernel)
+{
+  FFT fft(kernel, xKernel, yKernel, xSource, ySource);
+  return fft.convolve(source);
+}
@@ -77,8 +77,25 @@ using namespace std;
 class FFT
 {
 public:
-	FFT();
+  /// \brief prepare to convolve many images of one size with one kernel
+  ///
+  /// The FFTW plans and the transformed kernel are made once, here.
+  ///
+  /// \param kernel       convolution kernel
+  /// \param xKernel      width of kernel
+  /// \param yKernel      height of kernel
+  /// \param xSource      width of the source images
+  /// \param ySource      height of the source images
+	FFT(float* kernel, int xKernel, int yKernel, int xSource, int ySource);
 	virtual ~FFT();
+
+  /// \brief convolve a source image with the prepared kernel
+  ///
+  /// Several threads may convolve with the same FFT at once.
+  ///
+  /// \return Returns the convolved image in the 'source' array. If the convolve fails, returns false
+  bool convolve(float* source) const;
+
   /// \brief convolve image and filter using FFTW
   ///
   /// \param source       source image
@@ -90,6 +107,23 @@ public:
   ///
   /// \return Returns the convolved image in the 'image' array. If the convolve fails, returns false
   static bool convolve(float* source, float* kernel, int xSource, int ySource, int xKernel, int yKernel);
+
+private:
+  int _xSource;
+  int _ySource;
+  int _xKernel;
+  int _yKernel;
+  int _xResPadded;
+  int _yResPadded;
+
+  //! largest kernel entry, for normalization
+  float _maxKernel;
+
+  //! kernel in frequency space
+  fftw_complex* _filterTransformed;
+
+  fftw_plan _forward;
+  fftw_plan _backward;
 };
 
 #endif
@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : LINEAR_QUADTREE.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "LINEAR_QUADTREE.h"
+
+//////////////////////////////////////////////////////////////////////
+// index a cell
+//////////////////////////////////////////////////////////////////////
+void LINEAR_QUADTREE::add(CELL* cell)
+{
+  int x, y;
+  position(cell, x, y);
+  _cells[key(cell->depth, x, y)] = cell;
+}
+
+//////////////////////////////////////////////////////////////////////
+// the neighbor (dx,dy) squares away, or the leaf covering it
+//////////////////////////////////////////////////////////////////////
+CELL* LINEAR_QUADTREE::neighbor(CELL* cell, int dx, int dy) const
+{
+  int x, y;
+  position(cell, x, y);
+  x += dx;
+  y += dy;
+
+  if (x < 0 || y < 0 || x >= (_xRoots << cell->depth) || y >= (_yRoots << cell->depth))
+    return NULL;
+
+  // the deepest cell covering the square, no deeper than this one.
+  // In a balanced tree that is at most a level or two up.
+  for (int depth = cell->depth; depth >= 0; depth--, x >>= 1, y >>= 1)
+  {
+    CELL* found = find(depth, x, y);
+    if (found) return found;
+  }
+  return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////
+// the leaf covering a square of the finest grid
+//////////////////////////////////////////////////////////////////////
+CELL* LINEAR_QUADTREE::leaf(int x, int y, int maxDepth) const
+{
+  // every ancestor of an indexed cell is indexed too, so binary
+  // search for the deepest level that covers the square
+  int low = 0;
+  int high = maxDepth;
+  while (low < high)
+  {
+    int middle = (low + high + 1) / 2;
+    if (find(middle, x >> (maxDepth - middle), y >> (maxDepth - middle)))
+      low = middle;
+    else
+      high = middle - 1;
+  }
+  return find(low, x >> (maxDepth - low), y >> (maxDepth - low));
+}
@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : LINEAR_QUADTREE.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef LINEAR_QUADTREE_H
+#define LINEAR_QUADTREE_H
+
+#include "CELL.h"
+#include <unordered_map>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////
+/// \brief Pointerless index of quadtree cells, keyed by level and
+/// Morton code
+///
+/// A cell at depth d covering grid square (x,y) of the grid of its
+/// depth has the key d in the top bits followed by the interleaved
+/// bits of x and y. The grid spans every tree of the forest, 2^d
+/// squares per root along each side. Keys of different depths never
+/// collide, and a neighbor or a descendant
+/// key is plain integer arithmetic, so lookups are hash probes instead
+/// of walks through parent pointers.
+///
+/// Grid y runs from south to north, like the cell bounds.
+//////////////////////////////////////////////////////////////////////
+class LINEAR_QUADTREE
+{
+public:
+  //! index for a forest of xRoots by yRoots trees
+  LINEAR_QUADTREE(int xRoots = 1, int yRoots = 1) :
+    _xRoots(xRoots), _yRoots(yRoots) {};
+
+  //! index a cell
+  void add(CELL* cell);
+
+  //! forget every cell
+  void clear() { _cells.clear(); };
+
+  //! number of indexed cells
+  int size() const { return (int)_cells.size(); };
+
+  //! the cell at depth d covering grid square (x,y), NULL if there isn't one
+  CELL* find(int depth, int x, int y) const {
+    unordered_map<unsigned long long, CELL*>::const_iterator found = _cells.find(key(depth, x, y));
+    return (found == _cells.end()) ? NULL : found->second;
+  };
+
+  /// \brief the neighbor (dx,dy) squares away at the same depth
+  ///
+  /// Like the CELL neighbor lookups, returns the same-depth cell if it
+  /// exists, otherwise the leaf covering that square, and NULL past the
+  /// edge of the domain.
+  CELL* neighbor(CELL* cell, int dx, int dy) const;
+
+  /// \brief the leaf covering a square of the finest grid
+  ///
+  /// \param x            square x index at depth maxDepth
+  /// \param y            square y index at depth maxDepth
+  /// \param maxDepth     depth of the finest grid
+  CELL* leaf(int x, int y, int maxDepth) const;
+
+  //! key of grid square (x,y) at a depth
+  static unsigned long long key(int depth, int x, int y) {
+    return ((unsigned long long)depth << 58) | (spread(x) | (spread(y) << 1));
+  };
+
+  //! grid square covered by a cell at its own depth
+  static void position(const CELL* cell, int& x, int& y) {
+    x = cell->ix;
+    y = cell->iy;
+  };
+
+private:
+  unordered_map<unsigned long long, CELL*> _cells;
+
+  //! trees along each side of the forest
+  int _xRoots;
+  int _yRoots;
+
+  //! put a zero bit between each bit of x
+  static unsigned long long spread(unsigned int x) {
+    unsigned long long bits = x;
+    bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFFULL;
+    bits = (bits | (bits << 8))  & 0x00FF00FF00FF00FFULL;
+    bits = (bits | (bits << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    bits = (bits | (bits << 2))  & 0x3333333333333333ULL;
+    bits = (bits | (bits << 1))  & 0x5555555555555555ULL;
+    return bits;
+  };
+};
+
+#endif
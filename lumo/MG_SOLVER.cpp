@@ -0,0 +1,339 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : MG_SOLVER.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "MG_SOLVER.h"
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+MG_SOLVER::MG_SOLVER(int iterations, int digits) :
+  CG_SOLVER(iterations, digits),
+  _standalone(false), _smooths(2), _coarseSmooths(32), _coarsestDepth(2),
+  _totalLevels(0)
+{
+}
+
+MG_SOLVER::~MG_SOLVER()
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// multigrid or conjugate gradient solve
+//////////////////////////////////////////////////////////////////////
+int MG_SOLVER::solve(vector<CELL*>& cells, vector<CELL*>* changed)
+{
+  if (!_standalone)
+    return CG_SOLVER::solve(cells, changed);
+
+  assemble(cells, changed);
+  buildHierarchy();
+
+  // start from the current potentials
+  MG_LEVEL& finest = _levels[0];
+  _system.gather(&finest.x[0]);
+  for (int x = 0; x < _listSize; x++)
+    finest.b[x] = _system.rhs[x];
+
+  // cycle until converged, or until float roundoff stops the
+  // residual from shrinking any further
+  float eps = pow(10.0f, (float)-_digits);
+  float maxR = maxResidual();
+  int i = 0;
+  while (i < _iterations && maxR > eps)
+  {
+    cycle(0);
+    i++;
+
+    float oldR = maxR;
+    maxR = maxResidual();
+    if (maxR > 0.9f * oldR)
+      break;
+  }
+
+  // copy the solution back into the tree
+  for (int x = 0; x < _listSize; x++)
+    _potential[x] = finest.x[x];
+  _system.scatter(_potential);
+
+  return i;
+}
+
+//////////////////////////////////////////////////////////////////////
+// build the preconditioner for the assembled system
+//////////////////////////////////////////////////////////////////////
+void MG_SOLVER::factor()
+{
+  if (_preconditioner == MULTIGRID)
+    buildHierarchy();
+  else
+    CG_SOLVER::factor();
+}
+
+//////////////////////////////////////////////////////////////////////
+// apply the preconditioner to the residual
+//////////////////////////////////////////////////////////////////////
+void MG_SOLVER::precondition()
+{
+  if (_preconditioner != MULTIGRID)
+  {
+    CG_SOLVER::precondition();
+    return;
+  }
+
+  // z = one V-cycle on Az = r, starting from zero
+  MG_LEVEL& finest = _levels[0];
+  for (int x = 0; x < _listSize; x++)
+  {
+    finest.b[x] = _residual[x];
+    finest.x[x] = 0.0f;
+  }
+  cycle(0);
+  for (int x = 0; x < _listSize; x++)
+    _z[x] = finest.x[x];
+}
+
+//////////////////////////////////////////////////////////////////////
+// build the coarse levels from the assembled system
+//////////////////////////////////////////////////////////////////////
+void MG_SOLVER::buildHierarchy()
+{
+  // find the deepest unknown
+  int depth = 0;
+  for (int x = 0; x < _system.rows; x++)
+    if (_system.cells[x]->depth > depth)
+      depth = _system.cells[x]->depth;
+
+  // the levels keep their vectors between solves, so this
+  // only allocates when the tree has grown
+  _totalLevels = 1;
+  if (_levels.size() < 1)
+    _levels.resize(1);
+  _levels[0].x.resize(_system.rows);
+  _levels[0].b.resize(_system.rows);
+
+  while (depth > _coarsestDepth && levelSystem(_totalLevels - 1).rows > 1)
+  {
+    if ((int)_levels.size() <= _totalLevels)
+      _levels.resize(_totalLevels + 1);
+    coarsen(_totalLevels - 1, depth);
+    _totalLevels++;
+    depth--;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// merge the cells at 'depth' into their parents and form the
+// Galerkin operator of the new level
+//////////////////////////////////////////////////////////////////////
+void MG_SOLVER::coarsen(int level, int depth)
+{
+  POISSON_SYSTEM& fine = levelSystem(level);
+  POISSON_SYSTEM& coarse = _levels[level + 1].system;
+  vector<int>& map = _levels[level].coarse;
+  int x;
+
+  // the rows are in depth first order, so the children of a
+  // parent always form one contiguous run
+  map.resize(fine.rows);
+  coarse.cells.clear();
+  for (x = 0; x < fine.rows; x++)
+  {
+    CELL* cell = fine.cells[x];
+    if (cell->depth == depth)
+      cell = cell->parent;
+    if (coarse.cells.empty() || coarse.cells.back() != cell)
+      coarse.cells.push_back(cell);
+    map[x] = coarse.cells.size() - 1;
+  }
+  coarse.rows = coarse.cells.size();
+  _levels[level + 1].x.resize(coarse.rows);
+  _levels[level + 1].b.resize(coarse.rows);
+
+  // sum the fine rows and columns of each parent
+  coarse.rowStart.resize(coarse.rows + 1);
+  coarse.diagonal.resize(coarse.rows);
+  coarse.columns.clear();
+  coarse.values.clear();
+  x = 0;
+  for (int y = 0; y < coarse.rows; y++)
+  {
+    int start = coarse.columns.size();
+    coarse.rowStart[y] = start;
+    coarse.diagonal[y] = 0.0f;
+
+    for (; x < fine.rows && map[x] == y; x++)
+    {
+      coarse.diagonal[y] += fine.diagonal[x];
+      for (int k = fine.rowStart[x]; k < fine.rowStart[x + 1]; k++)
+      {
+        int column = map[fine.columns[k]];
+
+        // couplings between siblings land on the diagonal
+        if (column == y)
+        {
+          coarse.diagonal[y] += fine.values[k];
+          continue;
+        }
+
+        // merge with an existing entry if there is one
+        int entry = start;
+        while (entry < (int)coarse.columns.size() && coarse.columns[entry] != column)
+          entry++;
+        if (entry == (int)coarse.columns.size())
+        {
+          coarse.columns.push_back(column);
+          coarse.values.push_back(0.0f);
+        }
+        coarse.values[entry] += fine.values[k];
+      }
+    }
+  }
+  coarse.rowStart[coarse.rows] = coarse.columns.size();
+}
+
+//////////////////////////////////////////////////////////////////////
+// V-cycle on the current x and b of 'level'
+//////////////////////////////////////////////////////////////////////
+void MG_SOLVER::cycle(int level)
+{
+  POISSON_SYSTEM& system = levelSystem(level);
+  MG_LEVEL& current = _levels[level];
+
+  // smooth the coarsest level until it is nearly solved
+  if (level == _totalLevels - 1)
+  {
+    for (int x = 0; x < _coarseSmooths; x++)
+    {
+      smooth(level, true);
+      smooth(level, false);
+    }
+    return;
+  }
+
+  for (int x = 0; x < _smooths; x++)
+    smooth(level, true);
+
+  // restrict the residual to the parents
+  MG_LEVEL& next = _levels[level + 1];
+  for (int y = 0; y < next.system.rows; y++)
+    next.b[y] = next.x[y] = 0.0f;
+  for (int y = 0; y < system.rows; y++)
+  {
+    float neighborSum = 0.0f;
+    for (int k = system.rowStart[y]; k < system.rowStart[y + 1]; k++)
+      neighborSum += current.x[system.columns[k]] * system.values[k];
+    next.b[current.coarse[y]] += current.b[y] - (neighborSum + current.x[y] * system.diagonal[y]);
+  }
+
+  cycle(level + 1);
+
+  // inject the correction back into the children
+  for (int y = 0; y < system.rows; y++)
+    current.x[y] += next.x[current.coarse[y]];
+
+  for (int x = 0; x < _smooths; x++)
+    smooth(level, false);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Gauss-Seidel sweep, forward or backward over the rows
+//////////////////////////////////////////////////////////////////////
+void MG_SOLVER::smooth(int level, bool forward)
+{
+  POISSON_SYSTEM& system = levelSystem(level);
+  float* x = &_levels[level].x[0];
+  float* b = &_levels[level].b[0];
+  
+  int start = forward ? 0 : system.rows - 1;
+  int end = forward ? system.rows : -1;
+  int step = forward ? 1 : -1;
+  for (int y = start; y != end; y += step)
+  {
+    float sum = b[y];
+    for (int k = system.rowStart[y]; k < system.rowStart[y + 1]; k++)
+      sum -= system.values[k] * x[system.columns[k]];
+    x[y] = sum / system.diagonal[y];
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// maximum residual of the finest level
+//////////////////////////////////////////////////////////////////////
+float MG_SOLVER::maxResidual()
+{
+  MG_LEVEL& finest = _levels[0];
+  float maxR = 0.0f;
+  for (int y = 0; y < _system.rows; y++)
+  {
+    float neighborSum = 0.0f;
+    for (int k = _system.rowStart[y]; k < _system.rowStart[y + 1]; k++)
+      neighborSum += finest.x[_system.columns[k]] * _system.values[k];
+    float residual = fabs(finest.b[y] - (neighborSum + finest.x[y] * _system.diagonal[y]));
+    if (residual > maxR)
+      maxR = residual;
+  }
+  return maxR;
+}
@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : MG_SOLVER.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef MG_SOLVER_H
+#define MG_SOLVER_H
+
+#include "CG_SOLVER.h"
+#include <vector>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// \brief One level of the multigrid hierarchy
+////////////////////////////////////////////////////////////////////
+struct MG_LEVEL
+{
+  POISSON_SYSTEM system;  ///< level operator, unused on the finest level
+  vector<int> coarse;     ///< row on the next coarser level of each row
+  vector<float> x;        ///< solution or correction
+  vector<float> b;        ///< right hand side or restricted residual
+};
+
+////////////////////////////////////////////////////////////////////
+/// \brief Multigrid Poisson solver built on the quadtree hierarchy.
+///
+/// Each coarser level merges the deepest cells of the level below
+/// into their quadtree parents, and the level operators are formed
+/// as transpose(P) * A * P, where P injects a parent's value into its
+/// children. V-cycles smooth with Gauss-Seidel, forward on the way
+/// down and backward on the way up, so a cycle is symmetric and can
+/// precondition conjugate gradient.
+////////////////////////////////////////////////////////////////////
+class MG_SOLVER : public CG_SOLVER
+{
+public:
+  //! constructor
+  MG_SOLVER(int iterations = 10, int digits = 8);
+  //! destructor
+  virtual ~MG_SOLVER();
+
+  /// \brief solve the Poisson problem
+  ///
+  /// Runs V-cycles until the residual stops shrinking if standalone()
+  /// is set, else conjugate gradient with the selected preconditioner.
+  virtual int solve(vector<CELL*>& cells, vector<CELL*>* changed = NULL);
+
+  //! accessor for running V-cycles without conjugate gradient
+  bool& standalone() { return _standalone; };
+
+protected:
+  bool _standalone;     ///< run V-cycles instead of conjugate gradient
+  int _smooths;         ///< Gauss-Seidel sweeps before and after each correction
+  int _coarseSmooths;   ///< symmetric Gauss-Seidel sweeps on the coarsest level
+  int _coarsestDepth;   ///< stop coarsening once cells reach this depth
+
+  //! the levels, finest first
+  vector<MG_LEVEL> _levels;
+
+  //! number of levels currently in use
+  int _totalLevels;
+
+  //! operator of a level, the finest is the assembled system
+  POISSON_SYSTEM& levelSystem(int level) {
+    return (level == 0) ? _system : _levels[level].system;
+  };
+
+  //! build the hierarchy if multigrid preconditioning is selected
+  virtual void factor();
+
+  //! apply one V-cycle if multigrid preconditioning is selected
+  virtual void precondition();
+
+  //! build the coarse levels from the assembled system
+  void buildHierarchy();
+
+  //! merge the cells at 'depth' on 'level' into their parents
+  void coarsen(int level, int depth);
+
+  //! V-cycle starting at 'level'
+  void cycle(int level);
+
+  //! Gauss-Seidel sweep on 'level'
+  void smooth(int level, bool forward);
+
+  //! maximum residual of the finest level
+  float maxResidual();
+};
+
+#endif
@@ -0,0 +1,400 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : NOISE_MASK.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "NOISE_MASK.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#ifdef WIN32
+#include <windows.h>
+#include <process.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#define getpid _getpid
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// bump this whenever the file layout or the generator changes
+#define NOISE_CACHE_VERSION 2
+
+// first bytes of every cache file
+struct NOISE_CACHE_HEADER
+{
+  char magic[8];            ///< "LUMOSBN"
+  unsigned int version;     ///< NOISE_CACHE_VERSION
+  unsigned int radius;      ///< bits of the float radius
+  unsigned int tiled;       ///< 1 if the samples tile
+  unsigned int seed;        ///< seed of the generator
+  unsigned int points;      ///< number of samples that follow
+  unsigned int generator;   ///< NOISE_GENERATOR used
+};
+
+// fill in a header for the current settings
+static void makeHeader(NOISE_CACHE_HEADER& header, float radius, 
+                       NOISE_GENERATOR generator, int points)
+{
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, "LUMOSBN");
+  header.version = NOISE_CACHE_VERSION;
+  memcpy(&header.radius, &radius, sizeof(float));
+  header.tiled = 1;
+  header.seed = BLUE_NOISE_SEED;
+  header.points = points;
+  header.generator = generator;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+NOISE_MASK::NOISE_MASK(int res, NOISE_GENERATOR generator, int threads) :
+  _res(res), _generator(generator), _buckets((res + NOISE_BUCKET_SIZE - 1) / NOISE_BUCKET_SIZE), _cached(false),
+  _points(NULL), _totalPoints(0), _mapping(NULL), _mappingSize(0)
+{
+  float radius = 5.0f / (float)res;
+  string filename = cacheFile(radius);
+
+  _cached = !filename.empty() && mapCache(filename, radius);
+  if (!_cached)
+  {
+    generate(radius, threads);
+    if (!filename.empty())
+      writeCache(filename, radius);
+  }
+
+  buildBuckets();
+
+  // the buckets are all that's needed from here on
+  unmapCache();
+  vector<float>().swap(_generated);
+  _points = NULL;
+  _totalPoints = 0;
+}
+
+NOISE_MASK::~NOISE_MASK()
+{
+  unmapCache();
+}
+
+//////////////////////////////////////////////////////////////////////
+// directory holding the cache files
+//////////////////////////////////////////////////////////////////////
+string NOISE_MASK::cacheDirectory()
+{
+  const char* directory = getenv("LUMOS_CACHE");
+  if (directory)
+    return string(directory);
+
+#ifdef WIN32
+  // the temp directory is already private to the user
+  directory = getenv("TEMP");
+  return directory ? string(directory) : string(".");
+#else
+  // a directory only this user can write to, never a shared one where
+  // someone else could plant a cache file or a symlink
+  string cache;
+  directory = getenv("XDG_CACHE_HOME");
+  if (directory && directory[0] == '/')
+    cache = string(directory);
+  else
+  {
+    directory = getenv("HOME");
+    if (!directory || directory[0] != '/')
+      return string();
+    cache = string(directory) + string("/.cache");
+    if (mkdir(cache.c_str(), 0700) != 0 && errno != EEXIST)
+      return string();
+  }
+
+  cache += string("/lumos");
+  if (mkdir(cache.c_str(), 0700) != 0 && errno != EEXIST)
+    return string();
+  return cache;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////
+// cache file name for a radius
+//////////////////////////////////////////////////////////////////////
+string NOISE_MASK::cacheFile(float radius) const
+{
+  string directory = cacheDirectory();
+  if (directory.empty())
+    return string();
+
+  unsigned int bits;
+  memcpy(&bits, &radius, sizeof(float));
+
+  ostringstream name;
+  name << directory << "/lumos_bluenoise_v" << NOISE_CACHE_VERSION 
+       << "_r" << hex << bits << dec << "_tiled_g" << _generator << "_s" << BLUE_NOISE_SEED << ".bin";
+  return name.str();
+}
+
+//////////////////////////////////////////////////////////////////////
+// map a cache file and check that it is the one we want
+//////////////////////////////////////////////////////////////////////
+bool NOISE_MASK::mapCache(const string& filename, float radius)
+{
+#ifdef WIN32
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, 
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(NOISE_CACHE_HEADER))
+  {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (!mapping)
+    return false;
+
+  // the view keeps the mapping alive
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!data)
+    return false;
+  _mapping = data;
+  _mappingSize = (size_t)size.QuadPart;
+#else
+  int file = open(filename.c_str(), O_RDONLY);
+  if (file < 0)
+    return false;
+  struct stat info;
+  if (fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(NOISE_CACHE_HEADER))
+  {
+    close(file);
+    return false;
+  }
+  void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if (data == MAP_FAILED)
+    return false;
+  _mapping = data;
+  _mappingSize = info.st_size;
+#endif
+
+  // make sure it was made with the same settings and isn't truncated
+  const NOISE_CACHE_HEADER* header = (const NOISE_CACHE_HEADER*)_mapping;
+  NOISE_CACHE_HEADER expected;
+  makeHeader(expected, radius, _generator, header->points);
+  size_t expectedSize = sizeof(NOISE_CACHE_HEADER) + 2 * sizeof(float) * (size_t)header->points;
+  if (memcmp(header, &expected, sizeof(NOISE_CACHE_HEADER)) != 0 || _mappingSize != expectedSize)
+  {
+    unmapCache();
+    return false;
+  }
+
+  // the samples all land in [-1,1], anything else is a damaged or
+  // planted file that would index outside the buckets
+  const float* points = (const float*)(header + 1);
+  for (size_t x = 0; x < 2 * (size_t)header->points; x++)
+    if (!(points[x] >= -1.0f && points[x] <= 1.0f))
+    {
+      unmapCache();
+      return false;
+    }
+
+  _points = points;
+  _totalPoints = header->points;
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// unmap the cache file
+//////////////////////////////////////////////////////////////////////
+void NOISE_MASK::unmapCache()
+{
+  if (!_mapping) return;
+
+#ifdef WIN32
+  UnmapViewOfFile(_mapping);
+#else
+  munmap(_mapping, _mappingSize);
+#endif
+  _mapping = NULL;
+  _mappingSize = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// run the blue noise generator
+//////////////////////////////////////////////////////////////////////
+void NOISE_MASK::generate(float radius, int threads)
+{
+  vector<Vec2> points;
+  if (_generator == PARALLEL_TILES)
+  {
+    THREAD_POOL pool(threads);
+    PARALLEL_BLUE_NOISE noise(radius);
+    noise.maximize(pool);
+    points.swap(noise.points);
+  }
+  else
+  {
+    BLUE_NOISE noise(radius);
+    noise.complete();
+    noise.maximize();
+    points.swap(noise.points);
+  }
+
+  _generated.resize(2 * points.size());
+  for (unsigned int x = 0; x < points.size(); x++)
+  {
+    _generated[2 * x] = points[x].x;
+    _generated[2 * x + 1] = points[x].y;
+  }
+  _totalPoints = points.size();
+  _points = _totalPoints ? &_generated[0] : NULL;
+}
+
+//////////////////////////////////////////////////////////////////////
+// write the samples to the cache
+//////////////////////////////////////////////////////////////////////
+void NOISE_MASK::writeCache(const string& filename, float radius)
+{
+  // write to a private file first and rename it into place, so other
+  // processes never map a half written cache. The file must be new, so
+  // a file or symlink already sitting at that name is never followed.
+#ifdef WIN32
+  ostringstream name;
+  name << filename << "." << getpid() << "." << (size_t)this << ".tmp";
+  string temporary = name.str();
+  int descriptor = _open(temporary.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY,
+                         _S_IREAD | _S_IWRITE);
+  if (descriptor < 0)
+    return;
+  FILE* file = _fdopen(descriptor, "wb");
+  if (!file)
+  {
+    _close(descriptor);
+    remove(temporary.c_str());
+    return;
+  }
+#else
+  string temporary = filename + string(".XXXXXX");
+  int descriptor = mkstemp(&temporary[0]);
+  if (descriptor < 0)
+    return;
+  FILE* file = fdopen(descriptor, "wb");
+  if (!file)
+  {
+    close(descriptor);
+    remove(temporary.c_str());
+    return;
+  }
+#endif
+
+  NOISE_CACHE_HEADER header;
+  makeHeader(header, radius, _generator, _totalPoints);
+  bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+  if (_totalPoints)
+    success = success && fwrite(_points, 2 * sizeof(float), _totalPoints, file) == (size_t)_totalPoints;
+  success = (fclose(file) == 0) && success;
+
+  if (!success || rename(temporary.c_str(), filename.c_str()) != 0)
+    remove(temporary.c_str());
+}
+
+//////////////////////////////////////////////////////////////////////
+// sort the samples into the buckets of the cells they land in
+//////////////////////////////////////////////////////////////////////
+void NOISE_MASK::buildBuckets()
+{
+  vector<int> buckets(_totalPoints);
+  _bucketStart.assign(_buckets * _buckets + 1, 0);
+  _offsets.resize(_totalPoints);
+
+  // count the samples in each bucket
+  for (int x = 0; x < _totalPoints; x++)
+  {
+    int i = (_points[2 * x] + 1.0f) * 0.5f * _res;
+    int j = (_points[2 * x + 1] + 1.0f) * 0.5f * _res;
+    i = (i < 0) ? 0 : ((i < _res) ? i : _res - 1);
+    j = (j < 0) ? 0 : ((j < _res) ? j : _res - 1);
+    buckets[x] = (i >> NOISE_BUCKET_SHIFT) + (j >> NOISE_BUCKET_SHIFT) * _buckets;
+    _offsets[x] = (i & (NOISE_BUCKET_SIZE - 1)) | ((j & (NOISE_BUCKET_SIZE - 1)) << NOISE_BUCKET_SHIFT);
+    _bucketStart[buckets[x] + 1]++;
+  }
+  for (int x = 0; x < _buckets * _buckets; x++)
+    _bucketStart[x + 1] += _bucketStart[x];
+
+  // scatter them into place
+  vector<int> next(_bucketStart.begin(), _bucketStart.end() - 1);
+  vector<unsigned char> offsets(_totalPoints);
+  for (int x = 0; x < _totalPoints; x++)
+    offsets[next[buckets[x]]++] = _offsets[x];
+  _offsets.swap(offsets);
+}
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : NOISE_MASK.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef NOISE_MASK_H
+#define NOISE_MASK_H
+
+#include "BlueNoise/BLUE_NOISE.h"
+#include "PARALLEL_BLUE_NOISE.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! log2 of the width of a bucket of grid cells
+#define NOISE_BUCKET_SHIFT 4
+
+//! width of a bucket of grid cells, small enough for a cell offset to fit in a byte
+#define NOISE_BUCKET_SIZE (1 << NOISE_BUCKET_SHIFT)
+
+//////////////////////////////////////////////////////////////////////
+/// \enum Ways of generating the blue noise samples
+//////////////////////////////////////////////////////////////////////
+enum NOISE_GENERATOR {BOUNDARY_SAMPLING, PARALLEL_TILES};
+
+//////////////////////////////////////////////////////////////////////
+/// \brief Blue noise sample locations rasterized to a grid
+///
+/// Cells of the quadtree that land on a sample become attractors. The
+/// mask never changes once built, so one mask can be shared by every
+/// simulation of the same resolution, including ones running on
+/// other threads.
+///
+/// Only a few percent of the grid cells hold a sample, so rather than
+/// storing a flag per cell, the grid is hashed into square buckets of
+/// NOISE_BUCKET_SIZE cells and each bucket lists the cells of its
+/// samples. Memory grows with the number of samples, a little over a
+/// byte each, instead of with the area of the grid.
+///
+/// Generating the samples dominates startup at high resolutions, and
+/// the generator is deterministic, so the sample points are cached on
+/// disk and memory mapped on later runs. Cache files are keyed by
+/// radius, tiling and seed. They live in the directory named by the
+/// LUMOS_CACHE environment variable, or a lumos directory in the
+/// user's cache directory ($XDG_CACHE_HOME or ~/.cache) if it is not
+/// set. Setting LUMOS_CACHE to an empty string turns caching off.
+//////////////////////////////////////////////////////////////////////
+class NOISE_MASK
+{
+public:
+  /// \brief generate the blue noise for a grid, or load it from the cache
+  ///
+  /// \param res          grid resolution, samples are 5 cells apart
+  /// \param generator    BLUE_NOISE boundary sampling, or the parallel
+  ///                     tiles of PARALLEL_BLUE_NOISE
+  /// \param threads      threads for the parallel generator
+  NOISE_MASK(int res, NOISE_GENERATOR generator = BOUNDARY_SAMPLING, int threads = 1);
+
+  //! destructor
+  ~NOISE_MASK();
+
+  //! grid resolution
+  int res() const { return _res; };
+
+  //! is there a sample in grid cell (x,y)?
+  bool sample(int x, int y) const {
+    int bucket = (x >> NOISE_BUCKET_SHIFT) + (y >> NOISE_BUCKET_SHIFT) * _buckets;
+    unsigned char offset = (x & (NOISE_BUCKET_SIZE - 1)) | 
+                           ((y & (NOISE_BUCKET_SIZE - 1)) << NOISE_BUCKET_SHIFT);
+    for (int i = _bucketStart[bucket]; i < _bucketStart[bucket + 1]; i++)
+      if (_offsets[i] == offset)
+        return true;
+    return false;
+  };
+
+  //! how the samples were generated
+  NOISE_GENERATOR generator() const { return _generator; };
+
+  //! number of blue noise samples
+  int totalPoints() const { return (int)_offsets.size(); };
+
+  //! were the samples loaded from the cache?
+  bool cached() const { return _cached; };
+
+  //! directory holding the cache files, empty if caching is off
+  static string cacheDirectory();
+
+private:
+  int _res;
+  NOISE_GENERATOR _generator;
+
+  //! buckets along each side of the grid
+  int _buckets;
+
+  //! samples of bucket b are at [_bucketStart[b], _bucketStart[b + 1])
+  vector<int> _bucketStart;
+
+  //! grid cell of each sample, as x + y * NOISE_BUCKET_SIZE within its bucket
+  vector<unsigned char> _offsets;
+
+  //! were the samples loaded from the cache?
+  bool _cached;
+
+  /// \brief sample positions in [-1,1] x [-1,1], x and y interleaved
+  ///
+  /// Only valid while the buckets are being built.
+  const float* _points;
+  int _totalPoints;
+
+  //! samples generated by this run, if they weren't mapped
+  vector<float> _generated;
+
+  //! mapped cache file, NULL if the samples were generated
+  void* _mapping;
+  size_t _mappingSize;
+
+  //! cache file name for a radius
+  string cacheFile(float radius) const;
+
+  //! map a cache file, false if it is missing or doesn't match
+  bool mapCache(const string& filename, float radius);
+
+  //! unmap the cache file
+  void unmapCache();
+
+  //! run the blue noise generator
+  void generate(float radius, int threads);
+
+  //! write the generated samples to a cache file
+  void writeCache(const string& filename, float radius);
+
+  //! sort the samples into the buckets of the cells they land in
+  void buildBuckets();
+};
+
+#endif
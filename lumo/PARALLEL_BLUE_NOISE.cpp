@@ -0,0 +1,249 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : PARALLEL_BLUE_NOISE.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "PARALLEL_BLUE_NOISE.h"
+#include <cmath>
+#include <algorithm>
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+PARALLEL_BLUE_NOISE::PARALLEL_BLUE_NOISE(float radius, unsigned long seed) :
+  radius(radius), _seed(seed)
+{
+  float distance = 2.0f * radius;
+  _gridSize = (int)ceil(2.0f * sqrt(2.0f) / distance);
+  _reach = (int)ceil(distance * _gridSize / 2.0f);
+  _tileSize = 4 * _reach;
+
+  // the phases need an even number of tiles to wrap around the domain.
+  // Rounding the grid up shrinks the cells, but at most doubles the
+  // reach, so it stays inside the next tile.
+  if (_gridSize >= 2 * _tileSize)
+  {
+    _tiles = (_gridSize + _tileSize - 1) / _tileSize;
+    _tiles += _tiles % 2;
+    _gridSize = _tiles * _tileSize;
+    _reach = (int)ceil(distance * _gridSize / 2.0f);
+  }
+  // too coarse to split up, fill it all at once
+  else
+  {
+    _tiles = 1;
+    _tileSize = _gridSize;
+  }
+  _cellSize = 2.0f / _gridSize;
+
+  // leave out the cells that are too far away to ever conflict
+  vector<pair<int, pair<int, int> > > offsets;
+  for (int j = -_reach; j <= _reach; j++)
+    for (int i = -_reach; i <= _reach; i++)
+    {
+      int xGap = (abs(i) > 1) ? abs(i) - 1 : 0;
+      int yGap = (abs(j) > 1) ? abs(j) - 1 : 0;
+      float gap = _cellSize * sqrt((float)(xGap * xGap + yGap * yGap));
+      if (gap < distance)
+        offsets.push_back(make_pair(i * i + j * j, make_pair(i, j)));
+    }
+  sort(offsets.begin(), offsets.end());
+  for (unsigned int x = 0; x < offsets.size(); x++)
+  {
+    _xOffsets.push_back(offsets[x].second.first);
+    _yOffsets.push_back(offsets[x].second.second);
+  }
+
+  _samples.resize(_gridSize * _gridSize);
+  _filled.assign(_gridSize * _gridSize, 0);
+}
+
+//////////////////////////////////////////////////////////////////////
+// fill the domain with samples
+//////////////////////////////////////////////////////////////////////
+void PARALLEL_BLUE_NOISE::maximize(THREAD_POOL& pool)
+{
+  int half = (_tiles + 1) / 2;
+  for (int phase = 0; phase < 4; phase++)
+  {
+    int xPhase = phase % 2;
+    int yPhase = phase / 2;
+
+    // one block per tile of the phase
+    pool.run(half * half, [&](int block) {
+      int x = xPhase + 2 * (block % half);
+      int y = yPhase + 2 * (block / half);
+      if (x < _tiles && y < _tiles)
+        fillTile(x, y);
+    });
+  }
+
+  points.clear();
+  for (int x = 0; x < _gridSize * _gridSize; x++)
+    if (_filled[x])
+      points.push_back(_samples[x]);
+}
+
+//////////////////////////////////////////////////////////////////////
+// fill tile (x,y) with samples
+//////////////////////////////////////////////////////////////////////
+void PARALLEL_BLUE_NOISE::fillTile(int x, int y)
+{
+  // each tile has its own stream, whichever thread fills it
+  PHILOX random(_seed, x + (unsigned long long)y * _tiles);
+  int xFirst = x * _tileSize;
+  int yFirst = y * _tileSize;
+
+  // grow off the samples of the tiles already filled around this one
+  vector<int> active;
+  for (int j = -_reach; j < _tileSize + _reach; j++)
+    for (int i = -_reach; i < _tileSize + _reach; i++)
+    {
+      int cell = (xFirst + i + _gridSize) % _gridSize + 
+                 ((yFirst + j + _gridSize) % _gridSize) * _gridSize;
+      if (_filled[cell])
+        active.push_back(cell);
+    }
+
+  // nothing to grow off, start from a random spot
+  if (active.empty())
+  {
+    Vec2 point(-1.0f + (xFirst + random.getFloatL() * _tileSize) * _cellSize,
+               -1.0f + (yFirst + random.getFloatL() * _tileSize) * _cellSize);
+    int cell = tryPoint(point, xFirst, yFirst);
+    if (cell >= 0)
+      active.push_back(cell);
+  }
+
+  // keep a hair further than the minimum distance, so rounding
+  // can't bring neighbors too close
+  float distance = 2.0f * radius * 1.00001f;
+  while (!active.empty())
+  {
+    // pick a random active sample
+    int pick = (int)(random.getFloatL() * active.size());
+    Vec2 center = _samples[active[pick]];
+    active[pick] = active.back();
+    active.pop_back();
+
+    for (int k = 0; k < PARALLEL_BLUE_NOISE_ATTEMPTS; k++)
+    {
+      float angle = 2.0f * (float)M_PI * random.getFloatL();
+      Vec2 point(center.x + distance * cos(angle), center.y + distance * sin(angle));
+
+      // wrap around the domain
+      if (point.x < -1.0f) point.x += 2.0f;
+      else if (point.x >= 1.0f) point.x -= 2.0f;
+      if (point.y < -1.0f) point.y += 2.0f;
+      else if (point.y >= 1.0f) point.y -= 2.0f;
+
+      int cell = tryPoint(point, xFirst, yFirst);
+      if (cell >= 0)
+        active.push_back(cell);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// add a sample to the tile if nothing is too close
+//////////////////////////////////////////////////////////////////////
+int PARALLEL_BLUE_NOISE::tryPoint(Vec2 point, int xFirst, int yFirst)
+{
+  int x = (int)((point.x + 1.0f) / _cellSize);
+  int y = (int)((point.y + 1.0f) / _cellSize);
+  x = (x < _gridSize) ? x : _gridSize - 1;
+  y = (y < _gridSize) ? y : _gridSize - 1;
+
+  // only this tile's cells are written to
+  if (x < xFirst || x >= xFirst + _tileSize || 
+      y < yFirst || y >= yFirst + _tileSize ||
+      _filled[x + y * _gridSize])
+    return -1;
+
+  float minimum = 4.0f * radius * radius;
+  bool inside = x >= _reach && x < _gridSize - _reach && 
+                y >= _reach && y < _gridSize - _reach;
+  for (unsigned int k = 0; k < _xOffsets.size(); k++)
+  {
+    int neighbor = inside ? (x + _xOffsets[k]) + (y + _yOffsets[k]) * _gridSize :
+                   (x + _xOffsets[k] + _gridSize) % _gridSize + 
+                   ((y + _yOffsets[k] + _gridSize) % _gridSize) * _gridSize;
+    if (!_filled[neighbor])
+      continue;
+
+    // distance to the neighbor, wrapping around the edges
+    float dx = point.x - _samples[neighbor].x;
+    float dy = point.y - _samples[neighbor].y;
+    if (dx < -1.0f) dx += 2.0f;
+    else if (dx > 1.0f) dx -= 2.0f;
+    if (dy < -1.0f) dy += 2.0f;
+    else if (dy > 1.0f) dy -= 2.0f;
+    if (dx * dx + dy * dy < minimum)
+      return -1;
+  }
+
+  _samples[x + y * _gridSize] = point;
+  _filled[x + y * _gridSize] = 1;
+  return x + y * _gridSize;
+}
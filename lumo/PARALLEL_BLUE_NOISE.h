@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : PARALLEL_BLUE_NOISE.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef PARALLEL_BLUE_NOISE_H
+#define PARALLEL_BLUE_NOISE_H
+
+#include "BlueNoise/BLUE_NOISE.h"
+#include "THREAD_POOL.h"
+#include <vector>
+
+using namespace std;
+
+//! random directions tried around each sample before giving up on it
+#define PARALLEL_BLUE_NOISE_ATTEMPTS 32
+
+//////////////////////////////////////////////////////////////////////
+/// \brief Poisson disk samples from tiles filled in parallel
+///
+/// An alternative to BLUE_NOISE that scales across cores. The domain
+/// is cut into square tiles, and every tile is filled by boundary
+/// sampling: new samples go on the disk around an existing one, in a
+/// random direction that doesn't come too close to any other. Tiles
+/// are wider than the minimum distance, so tiles in the same one of
+/// four checkerboard phases can't affect each other and are filled in
+/// parallel. Later phases grow off the samples of the tiles next to
+/// them, so the seams are packed as tightly as the insides.
+///
+/// Each tile draws from its own PHILOX stream, so the samples don't
+/// depend on the number of threads. Like BLUE_NOISE, samples are at
+/// least 2 * radius apart and tile [-1,1] x [-1,1].
+//////////////////////////////////////////////////////////////////////
+class PARALLEL_BLUE_NOISE
+{
+public:
+  /// \brief constructor
+  ///
+  /// \param radius       samples are kept at least 2 * radius apart
+  /// \param seed         seed of the random streams
+  PARALLEL_BLUE_NOISE(float radius, unsigned long seed = BLUE_NOISE_SEED);
+
+  //! fill the domain with samples
+  void maximize(THREAD_POOL& pool);
+
+  //! final samples, in grid cell order
+  vector<Vec2> points;
+
+  //! half the minimum distance between samples
+  float radius;
+
+private:
+  unsigned long _seed;
+
+  /// \brief grid cells along each side
+  ///
+  /// A cell's diagonal is no longer than the minimum distance, so no
+  /// cell holds more than one sample.
+  int _gridSize;
+
+  //! width of a grid cell
+  float _cellSize;
+
+  //! cells either side that can hold a sample closer than 2 * radius
+  int _reach;
+
+  //! grid cells along each side of a tile
+  int _tileSize;
+
+  //! tiles along each side
+  int _tiles;
+
+  /// \brief cells around a sample that may hold a neighbor too close to it
+  ///
+  /// Sorted nearest first, so crowded spots are rejected quickly.
+  vector<int> _xOffsets;
+  vector<int> _yOffsets;
+
+  //! sample in each cell, valid where _filled is set
+  vector<Vec2> _samples;
+  vector<unsigned char> _filled;
+
+  //! fill tile (x,y) with samples
+  void fillTile(int x, int y);
+
+  //! add a sample if nothing is too close, returning its cell or -1
+  int tryPoint(Vec2 point, int xFirst, int yFirst);
+};
+
+#endif
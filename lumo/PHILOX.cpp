@@ -0,0 +1,210 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : PHILOX.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "PHILOX.h"
+#include <cstring>
+
+// round multipliers and key increments from Salmon et al. 2011
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+//! blocks generated together by the bulk draws
+#define PHILOX_BULK 8
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+PHILOX::PHILOX(unsigned long long seed, unsigned long long stream)
+{
+  this->seed(seed, stream);
+}
+
+//////////////////////////////////////////////////////////////////////
+// restart at the beginning of a stream
+//////////////////////////////////////////////////////////////////////
+void PHILOX::seed(unsigned long long seed, unsigned long long stream)
+{
+  _key[0] = (unsigned int)seed;
+  _key[1] = (unsigned int)(seed >> 32);
+  _stream = stream;
+  _counter = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// jump to a draw in the current stream
+//////////////////////////////////////////////////////////////////////
+void PHILOX::seek(unsigned long long counter)
+{
+  _counter = counter;
+  if (_counter & 3)
+    refill();
+}
+
+//////////////////////////////////////////////////////////////////////
+// generate the block holding the current draw
+//////////////////////////////////////////////////////////////////////
+void PHILOX::refill()
+{
+  unsigned long long index = _counter >> 2;
+  unsigned int counter[4] = {(unsigned int)index, (unsigned int)(index >> 32),
+                             (unsigned int)_stream, (unsigned int)(_stream >> 32)};
+  block(_key, counter, _buffer);
+}
+
+//////////////////////////////////////////////////////////////////////
+// the Philox4x32-10 bijection
+//////////////////////////////////////////////////////////////////////
+void PHILOX::block(const unsigned int key[2], const unsigned int counter[4], unsigned int out[4])
+{
+  unsigned int k0 = key[0], k1 = key[1];
+  unsigned int c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  for (int round = 0; round < 10; round++)
+  {
+    unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0;
+    unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2;
+    c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (unsigned int)p1;
+    c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (unsigned int)p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+//////////////////////////////////////////////////////////////////////
+// fill an array with random numbers on [0,0xffffffff]
+//////////////////////////////////////////////////////////////////////
+void PHILOX::getInt32(unsigned int* out, int size)
+{
+  int x = 0;
+
+  // finish off the current block
+  while (x < size && (_counter & 3))
+    out[x++] = getInt32();
+
+  // whole blocks, several at once with each word in its own array so
+  // the rounds run across the blocks in vector registers
+  while (size - x >= 4 * PHILOX_BULK)
+  {
+    unsigned long long index = _counter >> 2;
+    unsigned int c0[PHILOX_BULK], c1[PHILOX_BULK], c2[PHILOX_BULK], c3[PHILOX_BULK];
+    for (int i = 0; i < PHILOX_BULK; i++)
+    {
+      c0[i] = (unsigned int)(index + i);
+      c1[i] = (unsigned int)((index + i) >> 32);
+      c2[i] = (unsigned int)_stream;
+      c3[i] = (unsigned int)(_stream >> 32);
+    }
+
+    unsigned int k0 = _key[0], k1 = _key[1];
+    for (int round = 0; round < 10; round++)
+    {
+      for (int i = 0; i < PHILOX_BULK; i++)
+      {
+        unsigned long long p0 = (unsigned long long)PHILOX_M0 * c0[i];
+        unsigned long long p1 = (unsigned long long)PHILOX_M1 * c2[i];
+        c0[i] = (unsigned int)(p1 >> 32) ^ c1[i] ^ k0;
+        c1[i] = (unsigned int)p1;
+        c2[i] = (unsigned int)(p0 >> 32) ^ c3[i] ^ k1;
+        c3[i] = (unsigned int)p0;
+      }
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+
+    for (int i = 0; i < PHILOX_BULK; i++)
+    {
+      out[x + 4 * i] = c0[i];
+      out[x + 4 * i + 1] = c1[i];
+      out[x + 4 * i + 2] = c2[i];
+      out[x + 4 * i + 3] = c3[i];
+    }
+    x += 4 * PHILOX_BULK;
+    _counter += 4 * PHILOX_BULK;
+  }
+
+  // and whatever is left over
+  while (x < size)
+    out[x++] = getInt32();
+}
+
+//////////////////////////////////////////////////////////////////////
+// fill an array with random numbers on [0,1)
+//////////////////////////////////////////////////////////////////////
+void PHILOX::getFloatL(float* out, int size)
+{
+  // the bits are generated in place, floats and ints are the same size
+  getInt32((unsigned int*)out, size);
+  for (int x = 0; x < size; x++)
+  {
+    unsigned int bits;
+    memcpy(&bits, &out[x], sizeof(unsigned int));
+    out[x] = (float)(bits >> 8) * (1.0f / 16777216.0f);
+  }
+}
@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : PHILOX.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+//! seed used when none is given
+#define PHILOX_SEED 123456
+
+//////////////////////////////////////////////////////////////////////
+/// \brief Counter-based random number generator, Philox4x32-10
+///
+/// Every 32-bit draw is a pure function of (seed, stream, counter),
+/// so any draw can be reached directly with seek() and independent
+/// streams can be handed to jobs and threads without any shared
+/// state. Results don't depend on the order streams are used in, or
+/// on which thread uses them.
+///
+/// The draw functions match the old Mersenne Twister RNG class.
+/// Bulk draws return exactly the same numbers as the same number of
+/// single draws, but generate several blocks at a time.
+//////////////////////////////////////////////////////////////////////
+class PHILOX
+{
+public:
+  /// \brief constructor
+  ///
+  /// \param seed         key of the generator
+  /// \param stream       independent sequence for this seed
+  PHILOX(unsigned long long seed = PHILOX_SEED, unsigned long long stream = 0);
+
+  //! restart at the beginning of a stream
+  void seed(unsigned long long seed, unsigned long long stream = 0);
+
+  //! jump to a draw in the current stream
+  void seek(unsigned long long counter);
+
+  //! number of draws made so far in the current stream
+  unsigned long long counter() const { return _counter; };
+
+  //! random number on [0,0xffffffff]
+  unsigned int getInt32() {
+    if ((_counter & 3) == 0) refill();
+    return _buffer[_counter++ & 3];
+  };
+
+  //! random number on [0,0x7fffffff]
+  int getInt31() { return (int)(getInt32() >> 1); };
+
+  //! random number on [0,1)
+  float getFloatL() { return (float)(getInt32() >> 8) * (1.0f / 16777216.0f); };
+
+  //! random number on [0,1]
+  double getDoubleLR() { return getInt32() * (1.0 / 4294967295.0); };
+
+  //! fill 'size' entries with random numbers on [0,0xffffffff]
+  void getInt32(unsigned int* out, int size);
+
+  //! fill 'size' entries with random numbers on [0,1)
+  void getFloatL(float* out, int size);
+
+  /// \brief the Philox4x32-10 bijection
+  ///
+  /// \param key          two 32-bit key words
+  /// \param counter      four 32-bit counter words
+  /// \param out          four random 32-bit words
+  static void block(const unsigned int key[2], const unsigned int counter[4], unsigned int out[4]);
+
+private:
+  unsigned int _key[2];
+  unsigned long long _stream;
+
+  //! draws made so far, the block counter is this divided by 4
+  unsigned long long _counter;
+
+  //! current block of four draws
+  unsigned int _buffer[4];
+
+  //! generate the block holding draw _counter
+  void refill();
+};
+
+#endif
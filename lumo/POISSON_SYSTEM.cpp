@@ -0,0 +1,285 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : POISSON_SYSTEM.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "POISSON_SYSTEM.h"
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+POISSON_SYSTEM::POISSON_SYSTEM() :
+  rows(0), slots(0)
+{
+}
+
+POISSON_SYSTEM::~POISSON_SYSTEM()
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// compute the Poisson stencil of a leaf from its neighbors,
+// returns the boundary terms of the rhs
+//////////////////////////////////////////////////////////////////////
+static float calcStencil(const CELL* cell, CELL* neighbors[8], float stencil[9])
+{
+  float invDx = (float)(1 << cell->depth);
+
+  // sum over faces
+  float deltaSum = 0.0f;
+  float bSum = 0.0f;
+
+  for (int x = 0; x < 4; x++)
+  {
+    int i = x * 2;
+    stencil[i] = 0.0f;
+    stencil[i+1] = 0.0f;
+    
+    // past the edge of the domain is grounded, same as a
+    // boundary at the same refinement level
+    if (neighbors[i] == NULL)
+      deltaSum += invDx;
+    else if (neighbors[i + 1] == NULL) {
+      // if it is the same refinement level (case 1)
+      if (cell->depth == neighbors[i]->depth) {
+        deltaSum += invDx;
+        if (!neighbors[i]->boundary)
+          stencil[i] = invDx;
+        else
+          bSum += (neighbors[i]->potential) * invDx;
+      }
+      // else it is less refined (case 3)
+      else {
+        deltaSum += 0.5f * invDx;
+        if (!neighbors[i]->boundary)
+          stencil[i] = 0.5f * invDx;
+        else
+          bSum += neighbors[i]->potential * 0.5f * invDx;
+      }
+    }
+    // if the neighbor is at a lower level (case 2)
+    else {
+      deltaSum += 2.0f * invDx;
+      if (!neighbors[i]->boundary)
+        stencil[i] = invDx;
+      else
+        bSum += neighbors[i]->potential * invDx;
+      if (!neighbors[i+1]->boundary)
+        stencil[i+1] = invDx;
+      else
+        bSum += neighbors[i+1]->potential * invDx;
+    }
+  }
+
+  stencil[8] = deltaSum;
+  return bSum;
+}
+
+//////////////////////////////////////////////////////////////////////
+// flag the old rows whose stencils can see a changed cell. A refined
+// cell is seen through the leaves bordering its children, an inserted
+// leaf through its own neighbors. The tree is balanced, so the
+// neighbors of a leaf are all leaves.
+//////////////////////////////////////////////////////////////////////
+void POISSON_SYSTEM::markStale(CELL* cell)
+{
+  CELL* neighbors[8];
+  int row;
+
+  if (cell->leaf())
+  {
+    if ((row = oldRow(cell)) >= 0) _stale[row] = 1;
+    cell->neighbors(neighbors);
+    for (int y = 0; y < 8; y++)
+      if (neighbors[y] && (row = oldRow(neighbors[y])) >= 0) _stale[row] = 1;
+    return;
+  }
+
+  // children that were refined again are on the list themselves
+  for (int x = 0; x < 4; x++)
+  {
+    CELL* child = cell->child(x);
+    if (!child->leaf()) continue;
+
+    child->neighbors(neighbors);
+    for (int y = 0; y < 8; y++)
+      if (neighbors[y] && (row = oldRow(neighbors[y])) >= 0) _stale[row] = 1;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// assemble the CSR arrays from the cell stencils
+//////////////////////////////////////////////////////////////////////
+void POISSON_SYSTEM::build(vector<CELL*>& leaves, vector<CELL*>* changed)
+{
+  int x;
+
+  // keep the last build around to copy the unchanged rows from
+  cells.swap(_oldCells);
+  _neighbors.swap(_oldNeighbors);
+  _stencils.swap(_oldStencils);
+  rhs.swap(_oldRhs);
+
+  // without a list of changes every row has to be computed again
+  _stale.assign(_oldCells.size(), (changed == NULL) ? 1 : 0);
+  if (changed)
+    for (x = 0; x < (int)changed->size(); x++)
+      markStale((*changed)[x]);
+  
+  // compute a new lexicographical order, remembering where
+  // each row was last time
+  rows = leaves.size();
+  cells.assign(leaves.begin(), leaves.end());
+  _oldRow.resize(rows);
+  for (x = 0; x < rows; x++)
+  {
+    int old = oldRow(cells[x]);
+    _oldRow[x] = (old >= 0 && !_stale[old]) ? old : -1;
+    cells[x]->index = x;
+  }
+
+  // the vectors keep their capacity, so this only allocates
+  // when the system has grown
+  rowStart.resize(rows + 1);
+  diagonal.resize(rows);
+  rhs.resize(rows);
+  columns.resize(8 * rows);
+  values.resize(8 * rows);
+  _neighbors.resize(8 * rows);
+  _stencils.resize(9 * rows);
+
+  // compute the stencils that changed and copy the rest, skipping
+  // the boundary neighbors since they are already folded into the rhs
+  int entry = 0;
+  for (x = 0; x < rows; x++)
+  {
+    CELL* currentCell = cells[x];
+    CELL** neighbors = &_neighbors[8 * x];
+    float* stencil = &_stencils[9 * x];
+    rowStart[x] = entry;
+
+    int old = _oldRow[x];
+    if (old < 0)
+    {
+      currentCell->neighbors(neighbors);
+      rhs[x] = calcStencil(currentCell, neighbors, stencil);
+    }
+    else
+    {
+      for (int y = 0; y < 8; y++)
+        neighbors[y] = _oldNeighbors[8 * old + y];
+      for (int y = 0; y < 9; y++)
+        stencil[y] = _oldStencils[9 * old + y];
+      rhs[x] = _oldRhs[old];
+    }
+
+    for (int y = 0; y < 8; y++)
+    {
+      CELL* neighbor = neighbors[y];
+      if (neighbor == NULL || neighbor->boundary)
+        continue;
+
+      columns[entry] = neighbor->index;
+      values[entry]  = -stencil[y];
+      entry++;
+    }
+    diagonal[x] = stencil[8];
+  }
+  rowStart[rows] = entry;
+
+  // copy the off-diagonals into slot-major order, padding the
+  // short rows with zeros that point back at the row itself
+  slots = 0;
+  for (x = 0; x < rows; x++)
+    if (rowStart[x + 1] - rowStart[x] > slots)
+      slots = rowStart[x + 1] - rowStart[x];
+  slotColumns.resize(slots * rows);
+  slotValues.resize(slots * rows);
+  for (x = 0; x < rows; x++)
+    for (int s = 0; s < slots; s++)
+    {
+      int k = rowStart[x] + s;
+      bool inRow = (k < rowStart[x + 1]);
+      slotColumns[s * rows + x] = inRow ? columns[k] : x;
+      slotValues[s * rows + x]  = inRow ? values[k] : 0.0f;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// copy the cell potentials into a flat array
+//////////////////////////////////////////////////////////////////////
+void POISSON_SYSTEM::gather(float* x)
+{
+  for (int i = 0; i < rows; i++)
+    x[i] = cells[i]->potential;
+}
+
+//////////////////////////////////////////////////////////////////////
+// copy a flat array back into the cell potentials
+//////////////////////////////////////////////////////////////////////
+void POISSON_SYSTEM::scatter(float* x)
+{
+  for (int i = 0; i < rows; i++)
+    cells[i]->potential = x[i];
+}
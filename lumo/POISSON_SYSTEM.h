@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : POISSON_SYSTEM.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef POISSON_SYSTEM_H
+#define POISSON_SYSTEM_H
+
+#include "CELL.h"
+#include <vector>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+/// \brief Quadtree Poisson system assembled into flat CSR arrays.
+///
+/// The stencils are computed from the quadtree once per solve, so the
+/// solver iterations never touch the cells. Each row's neighbors and
+/// stencil are kept between builds, and only rows next to cells that
+/// changed since the last build are computed again.
+/// Row i of the matrix is
+///
+/// \verbatim
+///   (Ax)_i = diagonal[i] * x[i] + 
+///            sum(values[k] * x[columns[k]]), rowStart[i] <= k < rowStart[i+1]
+/// \endverbatim
+///
+/// The off-diagonals are also kept in slot-major order, where entry s
+/// of row i sits at s * rows + i, so that vector kernels can work on
+/// several consecutive rows at once.
+////////////////////////////////////////////////////////////////////
+class POISSON_SYSTEM
+{
+public:
+  //! constructor
+  POISSON_SYSTEM();
+  //! destructor
+  virtual ~POISSON_SYSTEM();
+
+  /// \brief number the unknowns and assemble their stencils
+  ///
+  /// \param cells        leaves not on the boundary
+  /// \param changed      cells refined or inserted since the last build,
+  ///                     the other rows reuse their stencils. NULL
+  ///                     computes every stencil from scratch.
+  void build(vector<CELL*>& cells, vector<CELL*>* changed = NULL);
+
+  //! copy the current potentials of the cells into 'x'
+  void gather(float* x);
+
+  //! copy 'x' back into the potentials of the cells
+  void scatter(float* x);
+
+  int rows;                   ///< number of unknowns
+  vector<int> rowStart;       ///< first off-diagonal of each row, plus an end marker
+  vector<int> columns;        ///< column of each off-diagonal
+  vector<float> values;       ///< off-diagonal matrix entries
+  vector<float> diagonal;     ///< diagonal matrix entries
+  vector<float> rhs;          ///< right hand side, including the boundary terms
+  vector<CELL*> cells;        ///< quadtree cell of each row
+
+  int slots;                  ///< longest row, the off-diagonals stored per row
+  vector<int> slotColumns;    ///< columns in slot-major order
+  vector<float> slotValues;   ///< off-diagonals in slot-major order, zero padded
+
+private:
+  vector<CELL*> _neighbors;   ///< neighbors of each row, 8 per row
+  vector<float> _stencils;    ///< stencil of each row, 9 per row
+
+  // the previous build, to copy the unchanged rows from
+  vector<CELL*> _oldCells;
+  vector<CELL*> _oldNeighbors;
+  vector<float> _oldStencils;
+  vector<float> _oldRhs;
+
+  //! old rows that have to be computed again
+  vector<char> _stale;
+
+  //! old row of each row, -1 if it has to be computed
+  vector<int> _oldRow;
+
+  //! old row of a cell, -1 if it wasn't one
+  int oldRow(CELL* cell) {
+    int row = cell->index;
+    return (row >= 0 && row < (int)_oldCells.size() && _oldCells[row] == cell) ? row : -1;
+  };
+
+  //! flag the old rows whose stencils can see a changed cell
+  void markStale(CELL* cell);
+};
+
+#endif
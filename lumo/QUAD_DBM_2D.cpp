@@ -69,7 +69,8 @@
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-QUAD_DBM_2D::QUAD_DBM_2D(int xRes, int yRes, int iterations) :
+QUAD_DBM_2D::QUAD_DBM_2D(int xRes, int yRes, int iterations, const NOISE_MASK* noise,
+                         NOISE_GENERATOR generator, int threads) :
   _xRes(xRes),
   _yRes(yRes),
   _bottomHit(0),
@@ -77,9 +78,15 @@ QUAD_DBM_2D::QUAD_DBM_2D(int xRes, int yRes, int iterations) :
   _quadPoisson(NULL),
   _dag(NULL),
   _skips(10),
-  _twister(123456)
+  _skipSolve(0),
+  _totalParticles(0),
+  _verbose(true),
+  _eta(1.0f),
+  _potentialScale(1.0f),
+  _potentialTotal(0.0),
+  _random(PHILOX_SEED)
 {
-  allocate();
+  allocate(noise, generator, threads);
   _dag = new DAG(_xRes, _yRes);
   
   // calculate dimensions
@@ -96,10 +103,11 @@ QUAD_DBM_2D::~QUAD_DBM_2D()
   deallocate();
 }
 
-void QUAD_DBM_2D::allocate()
+void QUAD_DBM_2D::allocate(const NOISE_MASK* noise, NOISE_GENERATOR generator, int threads)
 {
-  _quadPoisson = new QUAD_POISSON(_xRes, _yRes, _iterations);
-  _xRes = _yRes = _quadPoisson->maxRes();
+  _quadPoisson = new QUAD_POISSON(_xRes, _yRes, _iterations, noise, generator, threads);
+  _xRes = _quadPoisson->xRes();
+  _yRes = _quadPoisson->yRes();
 }
 
 void QUAD_DBM_2D::deallocate()
@@ -108,6 +116,32 @@ void QUAD_DBM_2D::deallocate()
   if (_quadPoisson) delete _quadPoisson;
 }
 
+//////////////////////////////////////////////////////////////////////
+// sampling weight of a candidate
+//////////////////////////////////////////////////////////////////////
+float QUAD_DBM_2D::weight(float potential)
+{
+  if (_eta != 1.0f)
+  {
+    potential *= _potentialScale;
+    CG_KERNELS::current().power(&potential, _eta, &potential, 1);
+  }
+  return potential;
+}
+
+//////////////////////////////////////////////////////////////////////
+// add a cell to the candidate list
+//////////////////////////////////////////////////////////////////////
+void QUAD_DBM_2D::addCandidate(CELL* cell)
+{
+  if (cell->candidate) return;
+
+  _candidates.push_back(cell);
+  _weights.push_back(weight(cell->potential));
+  _potentialTotal += cell->potential;
+  cell->candidate = true;
+}
+
 //////////////////////////////////////////////////////////////////////
 // check neighbors for any candidate nodes
 //////////////////////////////////////////////////////////////////////
@@ -115,58 +149,33 @@ void QUAD_DBM_2D::checkForCandidates(CELL* cell)
 {
   int maxDepth = _quadPoisson->maxDepth();
   
-  CELL* north = cell->northNeighbor();
+  CELL* north = _quadPoisson->northNeighbor(cell);
   if (north) {
     if (north->depth == maxDepth) {
-      if (!north->candidate) {
-        _candidates.push_back(north);
-        north->candidate = true;
-      }
+      addCandidate(north);
 
-      CELL* northeast = north->eastNeighbor();
-      if (northeast && !northeast->candidate) {
-        _candidates.push_back(northeast);
-        northeast->candidate = true;
-      }
-      CELL* northwest = north->westNeighbor();
-      if (northwest && !northwest->candidate) {
-        _candidates.push_back(northwest);
-        northwest->candidate = true;
-      }
+      CELL* northeast = _quadPoisson->eastNeighbor(north);
+      if (northeast) addCandidate(northeast);
+      CELL* northwest = _quadPoisson->westNeighbor(north);
+      if (northwest) addCandidate(northwest);
     }
   }
 
-  CELL* east = cell->eastNeighbor();
-  if (east && !east->candidate) {
-    _candidates.push_back(east);
-    east->candidate = true;
-  }
+  CELL* east = _quadPoisson->eastNeighbor(cell);
+  if (east) addCandidate(east);
   
-  CELL* south = cell->southNeighbor();
+  CELL* south = _quadPoisson->southNeighbor(cell);
   if (south) {
-    if (!south->candidate) {
-      _candidates.push_back(south);
-      south->candidate = true;
-    }
-
-    CELL* southeast = south->eastNeighbor();
-    if (southeast && !southeast->candidate) {
-      _candidates.push_back(southeast);
-      southeast->candidate = true;
-    }
+    addCandidate(south);
 
-    CELL* southwest = south->westNeighbor();
-    if (southwest && !southwest->candidate) {
-      _candidates.push_back(southwest);
-      southwest->candidate = true;
-    }
+    CELL* southeast = _quadPoisson->eastNeighbor(south);
+    if (southeast) addCandidate(southeast);
+    CELL* southwest = _quadPoisson->westNeighbor(south);
+    if (southwest) addCandidate(southwest);
   }
 
-  CELL* west = cell->westNeighbor();
-  if (west && !west->candidate) {
-    _candidates.push_back(west);
-    west->candidate = true;
-  }
+  CELL* west = _quadPoisson->westNeighbor(cell);
+  if (west) addCandidate(west);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -174,112 +183,137 @@ void QUAD_DBM_2D::checkForCandidates(CELL* cell)
 //////////////////////////////////////////////////////////////////////
 bool QUAD_DBM_2D::addParticle()
 {
-  static float invSqrtTwo = 1.0f / sqrt(2.0f);
-  static int totalParticles = 0;
-  static int skipSolve = 0;
- 
   // compute the potential
   int iterations = 0;
-  if (!skipSolve)
+  if (!_skipSolve)
+  {
     iterations = _quadPoisson->solve();
-  skipSolve++;
-  if (skipSolve == _skips) skipSolve = 0;
 
-  // construct probability distribution
-  vector<float> probabilities;
-  float totalPotential = 0.0f;
-  for (int x = 0; x < _candidates.size(); x++)
-  {
-    if (_candidates[x]->candidate)
+    // drop the cells added since the last solve, keeping the rest in
+    // order, so the refill only sees the front and not every particle
+    // that was ever a candidate
+    int live = 0;
+    for (unsigned int x = 0; x < _candidates.size(); x++)
+      if (_candidates[x]->state == EMPTY)
+        _candidates[live++] = _candidates[x];
+    _candidates.resize(live);
+    _weights.truncate(live);
+
+    // the solve moved every potential on the front, so refill the
+    // whole sampler. Between solves only the added cell and the new
+    // candidates change, and those are updated one at a time.
+    float* weights = _weights.weights();
+    float maxPotential = 0.0f;
+    _potentialTotal = 0.0;
+    for (int x = 0; x < live; x++)
     {
-      probabilities.push_back(_candidates[x]->potential);
-      totalPotential += _candidates[x]->potential;
+      weights[x] = _candidates[x]->potential;
+      _potentialTotal += weights[x];
+      if (weights[x] > maxPotential) maxPotential = weights[x];
     }
-    else
-      probabilities.push_back(0.0f);
+
+    // small potentials raised to a large eta underflow, so scale the
+    // largest one to 1 first. The scale cancels out of the sampling.
+    if (_eta != 1.0f)
+    {
+      _potentialScale = (maxPotential > 0.0f) ? 1.0f / maxPotential : 1.0f;
+      for (int x = 0; x < live; x++)
+        weights[x] *= _potentialScale;
+      CG_KERNELS::current().power(weights, _eta, weights, live);
+    }
+    _weights.rebuild();
   }
-  
+  _skipSolve++;
+  if (_skipSolve == _skips) _skipSolve = 0;
+
   // get all the candidates
   // if none are left, stop
   if (_candidates.size() == 0) {
     return false;
   }
  
-  // if there is not enough potential, go Brownian
+  // if there is not enough potential, go Brownian. This looks at the
+  // raw potentials, the weights can be vanishingly small for large eta.
   int toAddIndex = 0;
-  if (totalPotential < 1e-8)
-    toAddIndex = _candidates.size() * _twister.getDoubleLR();
+  if (_potentialTotal < 1e-8)
+    toAddIndex = _candidates.size() * _random.getDoubleLR();
   // else follow DBM algorithm
   else
-  {
-    // add a neighbor
-    float random = _twister.getDoubleLR();
-    float invTotalPotential = 1.0f / totalPotential;
-    float potentialSeen = probabilities[0] * invTotalPotential;
-    while ((potentialSeen < random) && (toAddIndex < _candidates.size()))
-    {
-      toAddIndex++;
-      potentialSeen += probabilities[toAddIndex] * invTotalPotential;
-    }
-  }
+    toAddIndex = _weights.choose(_random.getDoubleLR());
+  if (toAddIndex < 0)
+    toAddIndex = _candidates.size() * _random.getDoubleLR();
+  if (toAddIndex >= (int)_candidates.size())
+    toAddIndex = _candidates.size() - 1;
+
+  _potentialTotal -= _candidates[toAddIndex]->potential;
+
   _candidates[toAddIndex]->boundary = true;
   _candidates[toAddIndex]->potential = 0.0f;
   _candidates[toAddIndex]->state = NEGATIVE;
+  _weights.set(toAddIndex, 0.0f);
 
   CELL* neighbor = NULL;
   CELL* added = _candidates[toAddIndex];
-  CELL* north = added->northNeighbor();
+  CELL* north = _quadPoisson->northNeighbor(added);
   if (north)
   {
     if (north->state == NEGATIVE)
       neighbor = north;
-    CELL* northeast = north->eastNeighbor();
+    CELL* northeast = _quadPoisson->eastNeighbor(north);
     if (northeast && northeast->state == NEGATIVE)
       neighbor = northeast;
-    CELL* northwest = north->westNeighbor();
+    CELL* northwest = _quadPoisson->westNeighbor(north);
     if (northwest && northwest->state == NEGATIVE)
       neighbor = northwest;
   }
-  CELL* east = added->eastNeighbor();
+  CELL* east = _quadPoisson->eastNeighbor(added);
   if (east && east->state == NEGATIVE)
     neighbor = east;
   
-  CELL* south = added->southNeighbor();
+  CELL* south = _quadPoisson->southNeighbor(added);
   if (south)
   {
     if (south->state == NEGATIVE)
       neighbor = south;
-    CELL* southeast = south->eastNeighbor();
+    CELL* southeast = _quadPoisson->eastNeighbor(south);
     if (southeast && southeast->state == NEGATIVE)
       neighbor = southeast;
-    CELL* southwest = south->westNeighbor();
+    CELL* southwest = _quadPoisson->westNeighbor(south);
     if (southwest && southwest->state == NEGATIVE)
       neighbor = southwest;
   }
-  CELL* west = added->westNeighbor();
+  CELL* west = _quadPoisson->westNeighbor(added);
   if (west && west->state == NEGATIVE)
     neighbor = west;
   
   // insert it as a node for bookkeeping
-  _quadPoisson->insert(added->center[0], added->center[1]);
+  _quadPoisson->insert(added->center(0), added->center(1));
   checkForCandidates(added);
 
   // insert into the dag
-  int newIndex = (int)(added->center[0] * _xRes) +
-                 (int)(added->center[1] * _yRes) * _xRes;
-  int neighborIndex = (int)(neighbor->center[0] * _xRes) +
-                      (int)(neighbor->center[1] * _yRes) * _xRes;
-  _dag->addSegment(newIndex, neighborIndex);
-
-  totalParticles++;
-  if (!(totalParticles % 200))
-    cout << " " << totalParticles;
+  _dag->addSegment(gridIndex(added), gridIndex(neighbor));
+
+  _totalParticles++;
+  if (_verbose && !(_totalParticles % 200))
+    cout << " " << _totalParticles;
  
   hitGround(added);
   
   return true;
 }
 
+//////////////////////////////////////////////////////////////////////
+// index of the finest grid square at the center of a cell, from its
+// integer square at its own depth
+//////////////////////////////////////////////////////////////////////
+int QUAD_DBM_2D::gridIndex(CELL* cell)
+{
+  int shift = _quadPoisson->maxDepth() - cell->depth;
+  int x = ((2 * cell->ix + 1) << shift) >> 1;
+  int y = ((2 * cell->iy + 1) << shift) >> 1;
+  return x + y * _xRes;
+}
+
 //////////////////////////////////////////////////////////////////////
 // hit ground yet?
 //////////////////////////////////////////////////////////////////////
@@ -291,71 +325,80 @@ bool QUAD_DBM_2D::hitGround(CELL* cell)
   if (!cell)
     return false;
 
+  // the diagonals are missing along the edges of the domain
   bool hit = false;
-  if (cell->northNeighbor())
+  CELL* north = _quadPoisson->northNeighbor(cell);
+  if (north)
   {
-    CELL* north = cell->northNeighbor();
+    CELL* northeast = _quadPoisson->eastNeighbor(north);
+    CELL* northwest = _quadPoisson->westNeighbor(north);
     if (north->state == POSITIVE)
       hit = true;
-    if (north->eastNeighbor()->state == POSITIVE)
+    if (northeast && northeast->state == POSITIVE)
       hit = true;
-    if (north->westNeighbor()->state == POSITIVE)
+    if (northwest && northwest->state == POSITIVE)
       hit = true;
   }
-  if (cell->eastNeighbor())
-    if (cell->eastNeighbor()->state == POSITIVE)
-      hit = true;
-  if (cell->southNeighbor())
+  CELL* east = _quadPoisson->eastNeighbor(cell);
+  if (east && east->state == POSITIVE)
+    hit = true;
+  CELL* south = _quadPoisson->southNeighbor(cell);
+  if (south)
   {
-    CELL* south = cell->southNeighbor();
+    CELL* southeast = _quadPoisson->eastNeighbor(south);
+    CELL* southwest = _quadPoisson->westNeighbor(south);
     if (south->state == POSITIVE)
       hit = true;
-    if (south->eastNeighbor()->state == POSITIVE)
+    if (southeast && southeast->state == POSITIVE)
       hit = true;
-    if (south->westNeighbor()->state == POSITIVE)
+    if (southwest && southwest->state == POSITIVE)
       hit = true;
   }
-  if (cell->westNeighbor())
-    if (cell->westNeighbor()->state == POSITIVE)
-      hit = true;
+  CELL* west = _quadPoisson->westNeighbor(cell);
+  if (west && west->state == POSITIVE)
+    hit = true;
   
   if (hit)
   {
-    _bottomHit = (int)(cell->center[0] * _xRes) +
-                 (int)(cell->center[1] * _yRes) * _xRes;
+    _bottomHit = gridIndex(cell);
     _dag->buildLeader(_bottomHit);
     return true;
   }
   return false;
 }
 
+#ifndef NO_OPENGL
 ////////////////////////////////////////////////////////////////////
 // drawing functions
 ////////////////////////////////////////////////////////////////////
 void QUAD_DBM_2D::draw() {
   glPushMatrix();
   glTranslatef(-0.5, -0.5, 0);
+
+  // fit the whole forest in the unit square
+  int roots = (_quadPoisson->xRoots() > _quadPoisson->yRoots()) ? 
+              _quadPoisson->xRoots() : _quadPoisson->yRoots();
+  glScalef(1.0f / roots, 1.0f / roots, 1.0f);
   
-  list<CELL*> leaves;
-  list<CELL*>::iterator cellIterator = leaves.begin();
-  _quadPoisson->getAllLeaves(leaves);
-  for (cellIterator = leaves.begin(); cellIterator != leaves.end(); cellIterator++)
+  vector<CELL*>& leaves = _quadPoisson->getAllLeaves();
+  for (unsigned int x = 0; x < leaves.size(); x++)
   {
-    float color = (*cellIterator)->potential;
+    float color = leaves[x]->potential;
 
-    if ((*cellIterator)->boundary) {
+    if (leaves[x]->boundary) {
       if (color <= 0.0f)
-        _quadPoisson->drawCell(*cellIterator, 0,0,0);
+        _quadPoisson->drawCell(leaves[x], 0,0,0);
       else
-        _quadPoisson->drawCell(*cellIterator, 0,0,color);
+        _quadPoisson->drawCell(leaves[x], 0,0,color);
     }
     else
-      _quadPoisson->drawCell(*cellIterator, color, 0,0);
+      _quadPoisson->drawCell(leaves[x], color, 0,0);
   }
   _quadPoisson->draw(NULL);
   
   glPopMatrix();
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////
 // read in attractors from an image
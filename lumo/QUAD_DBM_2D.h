@@ -67,9 +67,13 @@
 #define QUAD_DBM_2D_H
 
 #include <vector>
-#include <gl/glut.h>
+#ifndef NO_OPENGL
+#include <GL/glut.h>
+#endif
 #include "DAG.h"
 #include "QUAD_POISSON.h"
+#include "SUM_TREE.h"
+#include "PHILOX.h"
 
 ////////////////////////////////////////////////////////////////////
 /// \brief Quadtree DBM solver. This is the highest level class.
@@ -82,7 +86,13 @@ public:
   /// \param xRes         maximum x resolution
   /// \param yRes         maximum y resolution
   /// \param iterations   maximum conjugate gradient iterations
-	QUAD_DBM_2D(int xRes = 128, int yRes = 128, int iterations = 10);
+  /// \param noise        blue noise to share, built from scratch if NULL
+  /// \param generator    how to build the blue noise if it isn't shared
+  /// \param threads      threads for the parallel blue noise generator
+	QUAD_DBM_2D(int xRes = 128, int yRes = 128, int iterations = 10, 
+              const NOISE_MASK* noise = NULL,
+              NOISE_GENERATOR generator = BOUNDARY_SAMPLING,
+              int threads = 1);
 
   //! destructor
 	virtual ~QUAD_DBM_2D();
@@ -94,6 +104,7 @@ public:
   /// \return returns true if a terminator as already been hit
   bool hitGround(CELL* cell = NULL);
  
+#ifndef NO_OPENGL
   //! draw the quadtree cells to OpenGL
   void draw();
 
@@ -105,6 +116,7 @@ public:
     _dag->draw();
     glPopMatrix();
   };
+#endif
   
   ////////////////////////////////////////////////////////////////
   // file IO
@@ -155,9 +167,30 @@ public:
   int inputWidth() { return _dag->inputWidth(); };
   //! access the y resolution of the input image
   int inputHeight() { return _dag->inputHeight(); };
+  //! access the quadtree Poisson solver
+  QUAD_POISSON* quadPoisson() { return _quadPoisson; };
+  //! access the number of particles added so far
+  int totalParticles() { return _totalParticles; };
+
+  /// \brief restart the random numbers from a new seed, before adding particles
+  ///
+  /// \param seed         seed of the bolt
+  /// \param stream       independent stream of random numbers for the seed
+  void seed(unsigned long seed, unsigned long stream = 0) { _random.seed(seed, stream); };
+
+  //! print the particle count as the simulation goes?
+  bool& verbose() { return _verbose; };
+
+  /// \brief access the dielectric breakdown exponent
+  ///
+  /// Candidates are picked with probability proportional to
+  /// pow(potential, eta). Higher values give fewer, straighter
+  /// branches, lower values give bushier bolts.
+  /// Set it before the first particle is added.
+  float& eta() { return _eta; };
 
 private:
-  void allocate();
+  void allocate(const NOISE_MASK* noise, NOISE_GENERATOR generator, int threads);
   void deallocate();
   
   ////////////////////////////////////////////////////////////////////
@@ -179,18 +212,50 @@ private:
 
   QUAD_POISSON* _quadPoisson;
 
-  // current candidate list
+  // current candidate list, cells added since the last solve are
+  // dropped at the next one
   vector<CELL*> _candidates;
 
+  // potential of each candidate, zero once it has been added
+  SUM_TREE _weights;
+
+  // add a cell to the candidate list if it isn't already a candidate
+  void addCandidate(CELL* cell);
+
   // check if any of the neighbors of cell should be added to the
   // candidate list
   void checkForCandidates(CELL* cell);
 
+  // index of the finest grid square at the center of a cell
+  int gridIndex(CELL* cell);
+
   // number of particles to add before doing another Poisson solve
   int _skips;
 
-  // Mersenne Twister
-  RNG _twister;
+  // particles added since the last Poisson solve
+  int _skipSolve;
+
+  // particles added so far
+  int _totalParticles;
+
+  // print the particle count?
+  bool _verbose;
+
+  // dielectric breakdown exponent
+  float _eta;
+
+  // scale that took the largest candidate potential to 1 at the
+  // last solve, applied before eta so the weights don't underflow
+  float _potentialScale;
+
+  // sum of the raw candidate potentials, for the Brownian fallback
+  double _potentialTotal;
+
+  // sampling weight of a candidate with the given potential
+  float weight(float potential);
+
+  // counter-based random numbers
+  PHILOX _random;
 };
 
 #endif
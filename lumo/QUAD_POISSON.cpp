@@ -64,48 +64,97 @@
 // 
 
 #include "QUAD_POISSON.h"
+#include <new>
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-QUAD_POISSON::QUAD_POISSON(int xRes, int yRes, int iterations) :
-  _root(new CELL(1.0f, 1.0f, 0.0f, 0.0f)),
-  _noise()
+QUAD_POISSON::QUAD_POISSON(int xRes, int yRes, int iterations, const NOISE_MASK* noise,
+                           NOISE_GENERATOR generator, int threads) :
+  _linear(NULL),
+  _leavesStale(true),
+  _iterations(iterations),
+  _firstSolve(true),
+  _noise(noise),
+  _ownNoise(NULL)
 {
-  _root->refine();
- 
-  // figure out the max depth needed
-  float xMax = log((float)xRes) / log(2.0f);
-  float yMax = log((float)yRes) / log(2.0f);
- 
-  float max = (xMax > yMax) ? xMax : yMax;
-  if (max - floor(max) > 1e-7)
-    max = max + 1;
-  max = floor(max);
-  
-  _maxRes = pow(2.0f, (float)max);
-  _maxDepth = max;
+  // figure out the max depth needed, and how many trees it
+  // takes to cover the domain at that depth
+  _maxDepth = depthFor(xRes, yRes);
+  _maxRes = pow(2.0f, (float)_maxDepth);
+  _xRoots = (xRes + _maxRes - 1) / _maxRes;
+  _yRoots = (yRes + _maxRes - 1) / _maxRes;
+
+  // the roots are all at depth 0, so they link up like siblings
+  CELL* block = NULL;
+  for (int y = 0; y < _yRoots; y++)
+    for (int x = 0; x < _xRoots; x++)
+    {
+      int index = x + y * _xRoots;
+      if (index % 4 == 0)
+        block = _pool.siblings();
+      _roots.push_back(new (block + index % 4) CELL(0, x, y));
+      if (x > 0)
+      {
+        _roots[index]->adjacent[3] = _roots[index - 1];
+        _roots[index - 1]->adjacent[1] = _roots[index];
+      }
+      if (y > 0)
+      {
+        _roots[index]->adjacent[2] = _roots[index - _xRoots];
+        _roots[index - _xRoots]->adjacent[0] = _roots[index];
+      }
+    }
+
+  // create the blue noise, unless someone already did
+  if (!_noise || _noise->res() != _maxRes || _noise->generator() != generator)
+    _noise = _ownNoise = new NOISE_MASK(_maxRes, generator, threads);
 
-  // create the blue noise
-  _noiseFunc = new BLUE_NOISE(5.0f / (float)_maxRes);
-  _noise = new bool[_maxRes * _maxRes];
-	_noiseFunc->complete();
-	_noiseFunc->maximize();
-  _noiseFunc->writeToBool(_noise, _maxRes);
+  _solver = new MG_SOLVER(iterations);
 
-  _solver = new CG_SOLVER(_maxDepth, iterations);
+  // refine the roots last, refine() may need the noise
+  _leaves = _roots;
+  for (unsigned int x = 0; x < _roots.size(); x++)
+    refine(_roots[x]);
 }
 
 QUAD_POISSON::~QUAD_POISSON()
 {
-  deleteGhosts();
-  delete _root;
   delete _solver;
-  delete _noiseFunc;
-  delete[] _noise;
+  delete _ownNoise;
+  delete _linear;
+}
+
+//////////////////////////////////////////////////////////////////////
+// depth of the trees covering a domain, their roots are as wide as
+// the shorter side rounded up to a power of two
+//////////////////////////////////////////////////////////////////////
+int QUAD_POISSON::depthFor(int xRes, int yRes)
+{
+  float xMax = log((float)xRes) / log(2.0f);
+  float yMax = log((float)yRes) / log(2.0f);
+ 
+  float min = (xMax < yMax) ? xMax : yMax;
+  if (min - floor(min) > 1e-7)
+    min = min + 1;
+  return (int)floor(min);
+}
+
+//////////////////////////////////////////////////////////////////////
+// the root covering a position, a point on a face goes west and
+// north like the walks down the trees
+//////////////////////////////////////////////////////////////////////
+CELL* QUAD_POISSON::rootAt(float xPos, float yPos)
+{
+  int x = (int)ceil(xPos) - 1;
+  int y = (int)floor(yPos);
+  x = (x < 0) ? 0 : ((x >= _xRoots) ? _xRoots - 1 : x);
+  y = (y < 0) ? 0 : ((y >= _yRoots) ? _yRoots - 1 : y);
+  return _roots[x + y * _xRoots];
 }
 
+#ifndef NO_OPENGL
 //////////////////////////////////////////////////////////////////////
 // draw boundaries to OGL
 //////////////////////////////////////////////////////////////////////
@@ -113,7 +162,8 @@ void QUAD_POISSON::draw(CELL* cell)
 {
   // see if it's the root
   if (cell == NULL) {
-    draw(_root);
+    for (unsigned int x = 0; x < _roots.size(); x++)
+      draw(_roots[x]);
     return;
   }
 
@@ -121,17 +171,17 @@ void QUAD_POISSON::draw(CELL* cell)
   glColor4f(1,1,1,0.1);
 
   glBegin(GL_LINE_STRIP);
-    glVertex2f(cell->bounds[1], 1.0f - cell->bounds[0]);
-    glVertex2f(cell->bounds[1], 1.0f - cell->bounds[2]);
-    glVertex2f(cell->bounds[3], 1.0f - cell->bounds[2]);
-    glVertex2f(cell->bounds[3], 1.0f - cell->bounds[0]);
-    glVertex2f(cell->bounds[1], 1.0f - cell->bounds[0]);
+    glVertex2f(cell->bounds(1), _yRoots - cell->bounds(0));
+    glVertex2f(cell->bounds(1), _yRoots - cell->bounds(2));
+    glVertex2f(cell->bounds(3), _yRoots - cell->bounds(2));
+    glVertex2f(cell->bounds(3), _yRoots - cell->bounds(0));
+    glVertex2f(cell->bounds(1), _yRoots - cell->bounds(0));
   glEnd();
   
   // draw the children
-  for (int x = 0; x < 4; x++)
-    if (cell->children[x] != NULL)
-      draw(cell->children[x]);
+  if (!cell->leaf())
+    for (int x = 0; x < 4; x++)
+      draw(cell->child(x));
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -142,12 +192,13 @@ void QUAD_POISSON::drawCell(CELL* cell, float r, float g, float b)
   // draw the current cell
   glColor4f(r,g,b,1.0f);
   glBegin(GL_QUADS);
-    glVertex2f(cell->bounds[1], 1.0f - cell->bounds[0]);
-    glVertex2f(cell->bounds[1], 1.0f - cell->bounds[2]);
-    glVertex2f(cell->bounds[3], 1.0f - cell->bounds[2]);
-    glVertex2f(cell->bounds[3], 1.0f - cell->bounds[0]);
+    glVertex2f(cell->bounds(1), _yRoots - cell->bounds(0));
+    glVertex2f(cell->bounds(1), _yRoots - cell->bounds(2));
+    glVertex2f(cell->bounds(3), _yRoots - cell->bounds(2));
+    glVertex2f(cell->bounds(3), _yRoots - cell->bounds(0));
   glEnd();
 }
+#endif
 
 //////////////////////////////////////////////////////////////////////
 // subdivide quadtree to max level for (xPos, yPos)
@@ -156,14 +207,13 @@ void QUAD_POISSON::drawCell(CELL* cell, float r, float g, float b)
 CELL* QUAD_POISSON::insert(float xPos, float yPos)
 {
   int currentDepth = 0;
-  CELL* currentCell = _root;
-  bool existed = true;
+  CELL* currentCell = rootAt(xPos, yPos);
  
   while (currentDepth < _maxDepth) {
     // find quadrant of current point
     float diff[2];
-    diff[0] = xPos - currentCell->center[0];
-    diff[1] = yPos - currentCell->center[1];
+    diff[0] = xPos - currentCell->center(0);
+    diff[1] = yPos - currentCell->center(1);
     int quadrant = 1;
     if (diff[0] > 0.0f) {
       if (diff[1] < 0.0f)
@@ -175,85 +225,52 @@ CELL* QUAD_POISSON::insert(float xPos, float yPos)
       quadrant = 0;
     
     // check if it exists
-    if (currentCell->children[quadrant] == NULL) {
-      existed = false;
-      currentCell->refine();
-    }
+    if (currentCell->leaf())
+      refine(currentCell);
     
     // recurse to next level
-    currentCell = currentCell->children[quadrant];
+    currentCell = currentCell->child(quadrant);
 
     // increment depth
     currentDepth++;
   }
-  // if we had to subdivide to get the cell, add them to the list
-  if (!existed)
-    for (int i = 0; i < 4; i++)
-    {
-      _smallestLeaves.push_back(currentCell->parent->children[i]);
-      setNoise(currentCell->parent->children[i]);
-    }
   
   ///////////////////////////////////////////////////////////////////
   // force orthogonal neighbors to be same depth
   // I have commented the first block, the rest follow the same flow
+  // refine() adds the new cells to the smallest leaves
   ///////////////////////////////////////////////////////////////////
 
   // see if neighbor exists
-  CELL* north = currentCell->northNeighbor();
-  if (north && north->depth != _maxDepth) {
+  CELL* north = northNeighbor(currentCell);
+  if (north)
     // while the neighbor needs to be refined
     while (north->depth != _maxDepth) {
 
       // refine it 
-      north->refine();
+      refine(north);
       
       // set to the newly refined neighbor
-      north = currentCell->northNeighbor();
-    }
-    // add newly created nodes to the list
-    for (int i = 0; i < 4; i++)
-    {
-      _smallestLeaves.push_back(north->parent->children[i]);
-      setNoise(north->parent->children[i]);
+      north = northNeighbor(currentCell);
     }
-  }
-  CELL* south = currentCell->southNeighbor();
-  if (south && south->depth != _maxDepth) {
+  CELL* south = southNeighbor(currentCell);
+  if (south)
     while (south->depth != _maxDepth) {
-      south->refine();
-      south = currentCell->southNeighbor();
+      refine(south);
+      south = southNeighbor(currentCell);
     }
-    for (int i = 0; i < 4; i++)
-    {
-      _smallestLeaves.push_back(south->parent->children[i]);
-      setNoise(south->parent->children[i]);
-    }
-  }
-  CELL* west = currentCell->westNeighbor();
-  if (west && west->depth != _maxDepth) {
+  CELL* west = westNeighbor(currentCell);
+  if (west)
     while (west->depth != _maxDepth) {
-      west->refine();
-      west = currentCell->westNeighbor();
-    }
-    for (int i = 0; i < 4; i++)
-    {
-      _smallestLeaves.push_back(west->parent->children[i]);
-      setNoise(west->parent->children[i]);
+      refine(west);
+      west = westNeighbor(currentCell);
     }
-  }
-  CELL* east = currentCell->eastNeighbor();
-  if (east && east->depth != _maxDepth) {
+  CELL* east = eastNeighbor(currentCell);
+  if (east)
     while (east->depth != _maxDepth) {
-      east->refine();
-      east = currentCell->eastNeighbor();
-    }
-    for (int i = 0; i < 4; i++)
-    {
-      _smallestLeaves.push_back(east->parent->children[i]);
-      setNoise(east->parent->children[i]);
+      refine(east);
+      east = eastNeighbor(currentCell);
     }
-  }
 
   ///////////////////////////////////////////////////////////////////
   // force diagonal neighbors to be same depth
@@ -262,57 +279,37 @@ CELL* QUAD_POISSON::insert(float xPos, float yPos)
   ///////////////////////////////////////////////////////////////////
   
   if (north) {
-    CELL* northwest = north->westNeighbor();
-    if (northwest && northwest->depth != _maxDepth) {
+    CELL* northwest = westNeighbor(north);
+    if (northwest)
       while (northwest->depth != _maxDepth) {
-        northwest->refine();
-        northwest = northwest->children[2];
-      }
-      for (int i = 0; i < 4; i++)
-      {
-        _smallestLeaves.push_back(northwest->parent->children[i]);
-        setNoise(northwest->parent->children[i]);
+        refine(northwest);
+        northwest = northwest->child(2);
       }
-    }
-    CELL* northeast = north->eastNeighbor();
-    if (northeast && northeast->depth != _maxDepth) {
+    CELL* northeast = eastNeighbor(north);
+    if (northeast)
       while (northeast->depth != _maxDepth) {
-        northeast->refine();
-        northeast= northeast->children[3];
+        refine(northeast);
+        northeast= northeast->child(3);
       }
-      for (int i = 0; i < 4; i++)
-      {
-        _smallestLeaves.push_back(northeast->parent->children[i]);
-        setNoise(northeast->parent->children[i]);
-      }
-    }
   }
   if (south) {
-    CELL* southwest = south->westNeighbor();
-    if (southwest && southwest->depth != _maxDepth) {
+    CELL* southwest = westNeighbor(south);
+    if (southwest)
       while (southwest->depth != _maxDepth) {
-        southwest->refine();
-        southwest = southwest->children[1];
+        refine(southwest);
+        southwest = southwest->child(1);
       }
-      for (int i = 0; i < 4; i++)
-      {
-        _smallestLeaves.push_back(southwest->parent->children[i]);
-        setNoise(southwest->parent->children[i]);
-      }
-    }
-    CELL* southeast = south->eastNeighbor();
-    if (southeast && southeast->depth != _maxDepth) {
+    CELL* southeast = eastNeighbor(south);
+    if (southeast)
       while (southeast->depth != _maxDepth) {
-        southeast->refine();
-        southeast= southeast->children[0];
-      }
-      for (int i = 0; i < 4; i++)
-      {
-        _smallestLeaves.push_back(southeast->parent->children[i]);
-        setNoise(southeast->parent->children[i]);
+        refine(southeast);
+        southeast= southeast->child(0);
       }
-    }
   }
+
+  // the caller may turn this cell into a boundary
+  _leavesStale = true;
+  _changed.push_back(currentCell);
   
   return currentCell;
 }
@@ -325,10 +322,8 @@ void QUAD_POISSON::setNoise(CELL* cell)
   if (!(cell->state == EMPTY))
     return;
   
-  int x = cell->center[0] * _maxRes;
-  int y = cell->center[1] * _maxRes;
-
-  if (_noise[x + y * _maxRes])
+  // the samples tile, so every tree can use the same ones
+  if (_noise->sample(cell->ix & (_maxRes - 1), cell->iy & (_maxRes - 1)))
   {
     cell->boundary = true;
     cell->state = ATTRACTOR;
@@ -338,253 +333,168 @@ void QUAD_POISSON::setNoise(CELL* cell)
 }
 
 //////////////////////////////////////////////////////////////////////
-// insert all leaves into a list
+// return all the leaves, in depth first order
 //////////////////////////////////////////////////////////////////////
-void QUAD_POISSON::getAllLeaves(list<CELL*>& leaves, CELL* currentCell)
+vector<CELL*>& QUAD_POISSON::getAllLeaves()
 {
-  // if we're at the root
-  if (currentCell == NULL)
-  {
-    getAllLeaves(leaves, _root);
-    return;
-  }
-  
-  // if we're at a leaf, add it to the list
-  if (currentCell->children[0] == NULL)
-  {
-    leaves.push_back(currentCell);
-    return;
-  }
- 
-  // if children exist, call recursively
-  for (int x = 0; x < 4; x++)
-    getAllLeaves(leaves, currentCell->children[x]);
+  updateLeaves();
+  return _leaves;
 }
 
 //////////////////////////////////////////////////////////////////////
-// insert all leaves not on the boundary into a list
+// return the unknowns of the next solve, balancing the tree first
+// like solve() does
 //////////////////////////////////////////////////////////////////////
-void QUAD_POISSON::getEmptyLeaves(list<CELL*>& leaves, CELL* currentCell)
+vector<CELL*>& QUAD_POISSON::getEmptyLeaves()
 {
-  // if we're at the root
-  if (currentCell == NULL) {
-    getEmptyLeaves(leaves, _root);
-    return;
-  }
-  
-  // if we're at a leaf, check if it's a boundary and then
-  // add it to the list
-  if (currentCell->children[0] == NULL) {
-    if (!(currentCell->boundary))
-      leaves.push_back(currentCell);
-    return;
-  }
-  
-  // if children exist, call recursively
-  for (int x = 0; x < 4; x++)
-    getEmptyLeaves(leaves, currentCell->children[x]);
+  balance();
+  updateLeaves();
+  return _emptyLeaves;
 }
 
 //////////////////////////////////////////////////////////////////////
-// balance the current tree
+// replace the leaves refined since the last update by their new
+// leaves, keeping the depth first order, then collect the ones not
+// on the boundary. Only the new parts of the tree are walked.
 //////////////////////////////////////////////////////////////////////
-void QUAD_POISSON::balance()
+void QUAD_POISSON::updateLeaves()
 {
-  // collect all the leaf nodes
-  list<CELL*> leaves;
-  getAllLeaves(leaves);
+  if (!_leavesStale) return;
 
-  // while the list is not empty
-  list<CELL*>::iterator cellIterator = leaves.begin();
-  for (cellIterator = leaves.begin(); cellIterator != leaves.end(); cellIterator++) {
-    CELL* currentCell = *cellIterator;
+  _patched.clear();
+  for (unsigned int x = 0; x < _leaves.size(); x++)
+  {
+    CELL* currentCell = _leaves[x];
+    if (currentCell->leaf())
+      _patched.push_back(currentCell);
+    else
+      appendLeaves(currentCell, _patched);
+  }
+  _leaves.swap(_patched);
 
-    // if a north neighbor exists
-    CELL* north = currentCell->northNeighbor();
-    if (north != NULL)
-      // while the neighbor is not balanced
-      while (north->depth < currentCell->depth - 1) {
-        // refine it
-        north->refine();
-
-        // add the newly refined nodes to the list of
-        // those to be checked
-        for (int x = 0; x < 4; x++)
-          leaves.push_back(north->children[x]);
-
-        // set the cell to the newly created one
-        north = currentCell->northNeighbor();
-      }
+  _emptyLeaves.clear();
+  for (unsigned int x = 0; x < _leaves.size(); x++)
+    if (!(_leaves[x]->boundary))
+      _emptyLeaves.push_back(_leaves[x]);
 
-    // the rest of the blocks flow the same as above
-    CELL* south = currentCell->southNeighbor();
-    if (south!= NULL)
-      while (south->depth < currentCell->depth - 1) {
-        south->refine();
-        for (int x = 0; x < 4; x++)
-          leaves.push_back(south->children[x]);
-        south = currentCell->southNeighbor();
-      }
-  
-    CELL* west = currentCell->westNeighbor();
-    if (west != NULL)
-      while (west->depth < currentCell->depth - 1) {
-        west->refine();
-        for (int x = 0; x < 4; x++)
-          leaves.push_back(west->children[x]);
-        west = currentCell->westNeighbor();
-      }
+  _leavesStale = false;
+}
 
-    CELL* east = currentCell->eastNeighbor();
-    if (east != NULL)
-      while (east->depth < currentCell->depth - 1) {
-        east->refine();
-        for (int x = 0; x < 4; x++)
-          leaves.push_back(east->children[x]);
-        east = currentCell->eastNeighbor();
-      }
+//////////////////////////////////////////////////////////////////////
+// append the leaves under a cell in depth first order
+//////////////////////////////////////////////////////////////////////
+void QUAD_POISSON::appendLeaves(CELL* cell, vector<CELL*>& leaves)
+{
+  // if we're at a leaf, add it to the list
+  if (cell->leaf())
+  {
+    leaves.push_back(cell);
+    return;
   }
+ 
+  // if children exist, call recursively
+  for (int x = 0; x < 4; x++)
+    appendLeaves(cell->child(x), leaves);
 }
 
 //////////////////////////////////////////////////////////////////////
-// build the neighbor lists of the current quadtree
+// balance the tree outward from the cells refined since the last
+// solve. Only the children of a refined cell can end up more than
+// one level finer than a neighbor, and only against the neighbors
+// of the cell itself. Refining those queues them in turn, so the
+// work is proportional to the number of refinements.
 //////////////////////////////////////////////////////////////////////
-void QUAD_POISSON::buildNeighbors()
+void QUAD_POISSON::balance()
 {
-  balance();
+  // refine() appends to the queue while we walk it
+  for (unsigned int x = 0; x < _refined.size(); x++) {
+    CELL* currentCell = _refined[x];
 
-  // collect all the leaf nodes
-  list<CELL*> leaves;
-  getAllLeaves(leaves);
-
-  list<CELL*>::iterator cellIterator = leaves.begin();
-  for (cellIterator = leaves.begin(); cellIterator != leaves.end(); cellIterator++)
-  {
-    CELL* currentCell = *cellIterator;
-    
-    // build north neighbors
-    CELL* north = currentCell->northNeighbor();
-    if (north != NULL) {
-      if (north->children[0] == NULL) {
-        currentCell->neighbors[0] = north;
-        currentCell->neighbors[1] = NULL;
-      }
-      else {
-        currentCell->neighbors[0] = north->children[3];
-        currentCell->neighbors[1] = north->children[2];
-      }
+    // if a north neighbor exists
+    CELL* north = northNeighbor(currentCell);
+    // while it is coarser than this cell, and so more than one
+    // level coarser than the children
+    while (north != NULL && north->depth < currentCell->depth) {
+      // refine it
+      refine(north);
+
+      // set the cell to the newly created one
+      north = northNeighbor(currentCell);
     }
-    // else build a ghost cell
-    else 
-      currentCell->neighbors[0] = new CELL(currentCell->depth);
-
-    // build east neighbors
-    CELL* east = currentCell->eastNeighbor();
-    if (east != NULL) {
-      if (east->children[0] == NULL) {
-        currentCell->neighbors[2] = east;
-        currentCell->neighbors[3] = NULL;
-      }
-      else {
-        currentCell->neighbors[2] = east->children[0];
-        currentCell->neighbors[3] = east->children[3];
-      }
+
+    // the rest of the blocks flow the same as above
+    CELL* south = southNeighbor(currentCell);
+    while (south != NULL && south->depth < currentCell->depth) {
+      refine(south);
+      south = southNeighbor(currentCell);
     }
-    // else build a ghost cell
-    else 
-      currentCell->neighbors[2] = new CELL(currentCell->depth);
-
-    // build south neighbors
-    CELL* south = currentCell->southNeighbor();
-    if (south != NULL) {
-      if (south->children[0] == NULL) {
-        currentCell->neighbors[4] = south;
-        currentCell->neighbors[5] = NULL;
-      }
-      else {
-        currentCell->neighbors[4] = south->children[1];
-        currentCell->neighbors[5] = south->children[0];
-      }
+
+    CELL* west = westNeighbor(currentCell);
+    while (west != NULL && west->depth < currentCell->depth) {
+      refine(west);
+      west = westNeighbor(currentCell);
     }
-    // else build a ghost cell
-    else 
-      currentCell->neighbors[4] = new CELL(currentCell->depth);
-
-    // build west neighbors
-    CELL* west = currentCell->westNeighbor();
-    if (west != NULL) {
-      if (west->children[0] == NULL) {
-        currentCell->neighbors[6] = west;
-        currentCell->neighbors[7] = NULL;
-      }
-      else {
-        currentCell->neighbors[6] = west->children[2];
-        currentCell->neighbors[7] = west->children[1];
-      }
+
+    CELL* east = eastNeighbor(currentCell);
+    while (east != NULL && east->depth < currentCell->depth) {
+      refine(east);
+      east = eastNeighbor(currentCell);
     }
-    // else build a ghost cell
-    else 
-      currentCell->neighbors[6] = new CELL(currentCell->depth);
   }
+  _refined.clear();
 }
 
 //////////////////////////////////////////////////////////////////////
-// delete ghost cells
+// refine a cell and remember it for the next solve
 //////////////////////////////////////////////////////////////////////
-void QUAD_POISSON::deleteGhosts(CELL* currentCell)
+void QUAD_POISSON::refine(CELL* cell)
 {
-  // if at the base, call on the root
-  if (currentCell == NULL)
-  {
-    deleteGhosts(_root);
-    return;
-  }
+  if (!cell->leaf()) return;
 
-  // if there are children, delete those too
-  if (currentCell->children[0]) {
-    // call recursively
+  cell->refine(_pool);
+  if (_linear)
     for (int x = 0; x < 4; x++)
-      deleteGhosts(currentCell->children[x]);
-    return;
-  }
-
-  // check the neighbors for stuff to delete
-  for (int x = 0; x < 8; x++) {
-    // if the neighbor exists
-    if (currentCell->neighbors[x])
-      // and if it is a ghost cell, delete it
-      if (currentCell->neighbors[x]->parent == NULL)
-        delete currentCell->neighbors[x];
-  }
+      _linear->add(cell->child(x));
+  _refined.push_back(cell);
+  _changed.push_back(cell);
+  _leavesStale = true;
+
+  // cells are only refined once, so the finest leaves
+  // each show up here exactly once
+  if (cell->depth == _maxDepth - 1)
+    for (int x = 0; x < 4; x++)
+    {
+      _smallestLeaves.push_back(cell->child(x));
+      setNoise(cell->child(x));
+    }
 }
 
 //////////////////////////////////////////////////////////////////////
 // solve the Poisson problem
 //////////////////////////////////////////////////////////////////////
 int QUAD_POISSON::solve() {
-  // maintain the quadtree
+  // maintain the quadtree around the cells that changed
+  // since the last solve
   balance();
-  buildNeighbors();
 
-  // retrieve leaves at the lowest level
-  _emptyLeaves.clear();
-  getEmptyLeaves(_emptyLeaves);
+  // patch the leaf sets where the tree changed
+  updateLeaves();
  
-  static bool firstSolve = true;
-  static int iterations = _solver->iterations();
-
   // do a full precision solve the first time
-  if (firstSolve)
+  if (_firstSolve)
   {
-    iterations = _solver->iterations();
     _solver->iterations() = 10000;
-    firstSolve = false;
+    _firstSolve = false;
   }
   else
-    _solver->iterations() = iterations;
+    _solver->iterations() = _iterations;
+ 
+  // only the stencils around the changed cells get recomputed
+  int iterations = _solver->solve(_emptyLeaves, &_changed);
+  _changed.clear();
  
   // return the number of iterations
-  return _solver->solve(_emptyLeaves);
+  return iterations;
 };
 
 
@@ -593,14 +503,24 @@ int QUAD_POISSON::solve() {
 //////////////////////////////////////////////////////////////////////
 CELL* QUAD_POISSON::getLeaf(float xPos, float yPos)
 {
-  CELL* currentCell = _root;
+  // a point on a face goes west and north, like the walk below
+  if (_linear)
+  {
+    int x = (int)ceil(xPos * _maxRes) - 1;
+    int y = (int)floor(yPos * _maxRes);
+    x = (x < 0) ? 0 : ((x >= xRes()) ? xRes() - 1 : x);
+    y = (y < 0) ? 0 : ((y >= yRes()) ? yRes() - 1 : y);
+    return _linear->leaf(x, y, _maxDepth);
+  }
+
+  CELL* currentCell = rootAt(xPos, yPos);
   
-  while (currentCell->children[0] != NULL)
+  while (!currentCell->leaf())
   {
     // find quadrant of current point
     float diff[2];
-    diff[0] = xPos - currentCell->center[0];
-    diff[1] = yPos - currentCell->center[1];
+    diff[0] = xPos - currentCell->center(0);
+    diff[1] = yPos - currentCell->center(1);
     int quadrant = 1;
     if (diff[0] > 0.0f)
     {
@@ -612,9 +532,40 @@ CELL* QUAD_POISSON::getLeaf(float xPos, float yPos)
     else
       quadrant = 0;
     
-    // check if it exists
-    if (currentCell->children[quadrant] != NULL)
-      currentCell = currentCell->children[quadrant];
+    // recurse to next level
+    currentCell = currentCell->child(quadrant);
   }
   return currentCell;
 }
+
+//////////////////////////////////////////////////////////////////////
+// switch between the Morton-keyed index and walking the tree
+//////////////////////////////////////////////////////////////////////
+void QUAD_POISSON::useLinearTree(bool linear)
+{
+  if (linear == (_linear != NULL))
+    return;
+
+  if (linear)
+  {
+    _linear = new LINEAR_QUADTREE(_xRoots, _yRoots);
+    for (unsigned int x = 0; x < _roots.size(); x++)
+      indexCells(_roots[x]);
+  }
+  else
+  {
+    delete _linear;
+    _linear = NULL;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// add a cell and all its descendants to the index
+//////////////////////////////////////////////////////////////////////
+void QUAD_POISSON::indexCells(CELL* cell)
+{
+  _linear->add(cell);
+  if (!cell->leaf())
+    for (int x = 0; x < 4; x++)
+      indexCells(cell->child(x));
+}
@@ -66,13 +66,16 @@
 #ifndef QUAD_POISSON_H
 #define QUAD_POISSON_H
 
-#include <gl/glut.h>
+#ifndef NO_OPENGL
+#include <GL/glut.h>
+#endif
 #include <cstdlib>
 #include "CELL.h"
-#include <list>
-#include "CG_SOLVER.h"
-#include "CG_SOLVER_SSE.h"
-#include "BlueNoise/BLUE_NOISE.h"
+#include "CELL_POOL.h"
+#include "LINEAR_QUADTREE.h"
+#include <vector>
+#include "MG_SOLVER.h"
+#include "NOISE_MASK.h"
 
 #include <iostream>
 
@@ -80,22 +83,37 @@ using namespace std;
 
 //////////////////////////////////////////////////////////////////////
 /// \brief Quadtree Poisson solver
+///
+/// The domain is covered by a forest of square quadtrees, as many as
+/// it takes to cover the input with roots as wide as its shorter side,
+/// rounded up to a power of two. A square input gets a single tree,
+/// while a wide panorama gets a row of them instead of being padded
+/// out to a square. Positions are measured in root widths, so the
+/// trees sit at integer positions and a cell of depth d is 2^-d wide.
 //////////////////////////////////////////////////////////////////////
 class QUAD_POISSON  
 {
 public:
   /// \brief quadtree constructor 
   ///
-  /// \param xRes         maximum x resolution
-  /// \param yRes         maximum y resolution
+  /// \param xRes         x resolution to cover
+  /// \param yRes         y resolution to cover
   /// \param iterations   maximum conjugate gradient iterations
+  /// \param noise        blue noise to share, built from scratch if NULL,
+  ///                     the wrong resolution or the wrong generator
+  /// \param generator    how to build the blue noise if it isn't shared
+  /// \param threads      threads for the parallel blue noise generator
 	QUAD_POISSON(int xRes, 
                int yRes,
-               int iterations = 10);
+               int iterations = 10,
+               const NOISE_MASK* noise = NULL,
+               NOISE_GENERATOR generator = BOUNDARY_SAMPLING,
+               int threads = 1);
   
   //! destructor
 	virtual ~QUAD_POISSON();
  
+#ifndef NO_OPENGL
   /// \brief OpenGL drawing function
   /// 
   /// \param cell         internally used param, should always be NULL externally
@@ -111,14 +129,15 @@ public:
                 float r = 1.0f, 
                 float g = 0.0f, 
                 float b = 0.0f);
+#endif
 
   //! Solve the Poisson problem
   int solve();  
  
   /// \brief insert point at maximum subdivision level
   ///
-  /// \param xPos         x position to insert at
-  /// \param yPos         y position to insert at
+  /// \param xPos         x position to insert at, in root widths
+  /// \param yPos         y position to insert at, in root widths
   CELL* insert(float xPos, float yPos);
 
   /// \brief insert point at maximum subdivision level
@@ -130,58 +149,142 @@ public:
   };
   
   /// \brief get all the leaf nodes
-  /// \return Leaves are returned in the 'leaves' param
-  void getAllLeaves(list<CELL*>& leaves, CELL* currentCell = NULL);
+  ///
+  /// Leaves are kept in depth first order, and only the parts of
+  /// the tree refined since the last call are walked to update them.
+  vector<CELL*>& getAllLeaves();
   
-  /// \brief  get all the leaf nodes at finest subdivision level
-  /// \return Leaves are  returned in the 'leaves' param
-  list<CELL*>& getSmallestLeaves() { return _smallestLeaves; };
+  /// \brief get the leaves that are not on the boundary
+  ///
+  /// These are the unknowns of the next solve. The tree is balanced
+  /// first, so they are the same ones solve() would use.
+  vector<CELL*>& getEmptyLeaves();
+
+  //! get all the leaf nodes at finest subdivision level, each once
+  vector<CELL*>& getSmallestLeaves() { return _smallestLeaves; };
 
-  //! maximum resolution accessor
+  //! resolution of one tree at the maximum depth
   int& maxRes() { return _maxRes; }
 
+  //! x resolution of the whole forest at the maximum depth
+  int xRes() { return _xRoots * _maxRes; };
+
+  //! y resolution of the whole forest at the maximum depth
+  int yRes() { return _yRoots * _maxRes; };
+
+  //! trees along x
+  int xRoots() { return _xRoots; };
+
+  //! trees along y
+  int yRoots() { return _yRoots; };
+
   //! maximum depth accessor
   int& maxDepth() { return _maxDepth; };
   
-  //! get leaf at coordinate (x,y)
+  //! get leaf at coordinate (x,y), in root widths
   CELL* getLeaf(float xPos, float yPos);
+
+  /// \brief look cells up in a Morton-keyed index instead of the
+  /// neighbor links cached in the cells
+  ///
+  /// Both give the same answers, so this only changes the speed.
+  void useLinearTree(bool linear);
+
+  //! is the Morton-keyed index in use?
+  bool linearTree() { return _linear != NULL; };
+
+  ////////////////////////////////////////////////////////////////
+  // neighbor lookups, through the index if it is in use
+  ////////////////////////////////////////////////////////////////
+  CELL* northNeighbor(CELL* cell) { return _linear ? _linear->neighbor(cell, 0, 1)  : cell->northNeighbor(); };
+  CELL* southNeighbor(CELL* cell) { return _linear ? _linear->neighbor(cell, 0, -1) : cell->southNeighbor(); };
+  CELL* eastNeighbor(CELL* cell)  { return _linear ? _linear->neighbor(cell, 1, 0)  : cell->eastNeighbor(); };
+  CELL* westNeighbor(CELL* cell)  { return _linear ? _linear->neighbor(cell, -1, 0) : cell->westNeighbor(); };
+
+  //! current Poisson solver accessor
+  MG_SOLVER* solver() { return _solver; };
+
+  //! blue noise accessor
+  const NOISE_MASK* noise() { return _noise; };
+
+  //! depth of the trees of the forest covering an xRes x yRes domain
+  static int depthFor(int xRes, int yRes);
   
 private:
-  //! root of the quadtree
-  CELL* _root;
+  //! storage of every cell in the tree, declared first so it outlives them
+  CELL_POOL _pool;
+
+  //! roots of the forest, row by row from the south west
+  vector<CELL*> _roots;
 
-  //! maximum resolution of quadtree
+  //! trees along x
+  int _xRoots;
+
+  //! trees along y
+  int _yRoots;
+
+  //! the root covering a position, faces go west and north
+  CELL* rootAt(float xPos, float yPos);
+
+  //! maximum resolution of each tree
   int _maxRes;
 
   //! maxmimum depth of quadtree
   int _maxDepth;
+
+  //! Morton-keyed index of every cell, NULL if lookups walk the tree
+  LINEAR_QUADTREE* _linear;
+
+  //! add a cell and all its descendants to the index
+  void indexCells(CELL* cell);
   
-  //! dependant leaves
-  list<CELL*> _emptyLeaves;
+  //! every leaf, in depth first order
+  vector<CELL*> _leaves;
+
+  //! scratch space for updating '_leaves'
+  vector<CELL*> _patched;
+
+  //! refined or new boundary cells since the leaves were updated?
+  bool _leavesStale;
+
+  //! dependant leaves, in the same order as '_leaves'
+  vector<CELL*> _emptyLeaves;
 
   //! smallest leaves
-  list<CELL*> _smallestLeaves;
+  vector<CELL*> _smallestLeaves;
   
-  //! current Poisson solver
-  CG_SOLVER* _solver;
-  
-  //! balance quadtree
-  void balance();
+  //! current Poisson solver, conjugate gradient unless told otherwise
+  MG_SOLVER* _solver;
 
-  //! get the leaf nodes not on the boundary
-  void getEmptyLeaves(list<CELL*>& leaves, CELL* currentCell = NULL);
+  //! conjugate gradient iterations after the first solve
+  int _iterations;
+
+  //! has the full precision first solve been done yet?
+  bool _firstSolve;
   
-  //! build the neighbor lists of the cells
-  void buildNeighbors();
+  //! queue of cells refined since the last balance
+  vector<CELL*> _refined;
+
+  //! cells refined or inserted since the last solve
+  vector<CELL*> _changed;
 
-  //! delete ghost cells
-  void deleteGhosts(CELL* currentCell = NULL);
+  //! refine a cell and remember it for the next solve
+  void refine(CELL* cell);
 
-  //! Blue noise function
-  BLUE_NOISE* _noiseFunc;
+  //! balance quadtree outward from the queued refined cells
+  void balance();
+
+  //! bring '_leaves' and '_emptyLeaves' up to date
+  void updateLeaves();
+
+  //! append the leaves under a cell in depth first order
+  void appendLeaves(CELL* cell, vector<CELL*>& leaves);
 
   //! Blue noise sample locations
-  bool* _noise;
+  const NOISE_MASK* _noise;
+
+  //! blue noise built by this tree, NULL if it is shared
+  NOISE_MASK* _ownNoise;
 
   //! check if a cell hits a noise node
   void setNoise(CELL* cell);
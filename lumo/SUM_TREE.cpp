@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : SUM_TREE.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "SUM_TREE.h"
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+SUM_TREE::SUM_TREE() :
+  _capacity(1), _size(0), _sums(2, 0.0f)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// append a weight, doubling the leaves when they run out
+//////////////////////////////////////////////////////////////////////
+void SUM_TREE::push_back(float weight)
+{
+  if (_size == _capacity)
+  {
+    vector<float> old(_sums.begin() + _capacity, _sums.end());
+    _capacity *= 2;
+    _sums.assign(2 * _capacity, 0.0f);
+    for (int x = 0; x < _size; x++)
+      _sums[_capacity + x] = old[x];
+    rebuild();
+  }
+
+  _size++;
+  set(_size - 1, weight);
+}
+
+//////////////////////////////////////////////////////////////////////
+// change a weight and the sums above it
+//////////////////////////////////////////////////////////////////////
+void SUM_TREE::set(int index, float weight)
+{
+  int node = _capacity + index;
+  _sums[node] = weight;
+  for (node /= 2; node > 0; node /= 2)
+    _sums[node] = _sums[2 * node] + _sums[2 * node + 1];
+}
+
+//////////////////////////////////////////////////////////////////////
+// remove all the weights
+//////////////////////////////////////////////////////////////////////
+void SUM_TREE::clear()
+{
+  _capacity = 1;
+  _size = 0;
+  _sums.assign(2, 0.0f);
+}
+
+//////////////////////////////////////////////////////////////////////
+// drop the weights past size, halving the leaves while they are less
+// than half used
+//////////////////////////////////////////////////////////////////////
+void SUM_TREE::truncate(int size)
+{
+  if (size >= _size)
+    return;
+
+  int capacity = _capacity;
+  while (capacity > 1 && capacity / 2 >= size)
+    capacity /= 2;
+
+  if (capacity != _capacity)
+  {
+    vector<float> old(_sums.begin() + _capacity, _sums.begin() + _capacity + size);
+    _capacity = capacity;
+    _sums.assign(2 * _capacity, 0.0f);
+    for (int x = 0; x < size; x++)
+      _sums[_capacity + x] = old[x];
+  }
+  else
+    for (int x = size; x < _size; x++)
+      _sums[_capacity + x] = 0.0f;
+  _size = size;
+}
+
+//////////////////////////////////////////////////////////////////////
+// recompute all the sums
+//////////////////////////////////////////////////////////////////////
+void SUM_TREE::rebuild()
+{
+  for (int node = _capacity - 1; node > 0; node--)
+    _sums[node] = _sums[2 * node] + _sums[2 * node + 1];
+}
+
+//////////////////////////////////////////////////////////////////////
+// walk down from the root, spending the random number on the way
+//////////////////////////////////////////////////////////////////////
+int SUM_TREE::choose(float random)
+{
+  if (_sums[1] <= 0.0f)
+    return -1;
+
+  float target = random * _sums[1];
+  int node = 1;
+  while (node < _capacity)
+  {
+    float left = _sums[2 * node];
+    float right = _sums[2 * node + 1];
+
+    // rounding can leave the target past the end of the right side,
+    // so never step into a side with nothing in it
+    if (right > 0.0f && (target >= left || left <= 0.0f))
+    {
+      target -= left;
+      node = 2 * node + 1;
+    }
+    else
+      node = 2 * node;
+  }
+  return node - _capacity;
+}
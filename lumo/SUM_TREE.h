@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : SUM_TREE.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef SUM_TREE_H
+#define SUM_TREE_H
+
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////
+/// \brief Weighted sampler over a growing array of weights
+///
+/// The weights sit in the leaves of a complete binary tree whose inner
+/// nodes hold the sums of their children, like the red-black tree in
+/// BlueNoise/WeightedDiscretePDF but indexed by position. Changing a
+/// weight and picking an index are both O(log n). Sums are recomputed
+/// from the children instead of adding deltas, so a weight set to zero
+/// is exactly zero and can never be picked.
+//////////////////////////////////////////////////////////////////////
+class SUM_TREE
+{
+public:
+  //! constructor
+  SUM_TREE();
+
+  //! number of weights
+  int size() { return _size; };
+
+  //! sum of all the weights
+  float total() { return _sums[1]; };
+
+  //! append a weight
+  void push_back(float weight);
+
+  //! change a weight
+  void set(int index, float weight);
+
+  //! remove all the weights
+  void clear();
+
+  /// \brief keep only the first size weights
+  ///
+  /// The leaves shrink to fit, so rebuild() stays proportional to the
+  /// weights still in use. Call rebuild() afterwards to update the sums.
+  void truncate(int size);
+
+  /// \brief direct access to the weights, for changing many at once
+  ///
+  /// Call rebuild() afterwards to update the sums.
+  float* weights() { return &_sums[_capacity]; };
+
+  //! recompute all the sums in O(n)
+  void rebuild();
+
+  /// \brief pick an index with probability proportional to its weight
+  ///
+  /// \param random       uniform random number in [0,1]
+  /// \return -1 if all the weights are zero
+  int choose(float random);
+
+private:
+  //! number of leaves, always a power of two
+  int _capacity;
+
+  //! number of weights in use
+  int _size;
+
+  /// \brief node k has children 2k and 2k+1, the root is node 1 and
+  /// leaf i is node _capacity + i
+  vector<float> _sums;
+};
+
+#endif
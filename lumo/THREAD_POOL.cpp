@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : THREAD_POOL.cpp
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#include "THREAD_POOL.h"
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+THREAD_POOL::THREAD_POOL(int threads) :
+  _task(NULL), _blocks(0), _next(0), _busy(0), _job(0), _quit(false)
+{
+  for (int x = 1; x < threads; x++)
+    _workers.push_back(thread(&THREAD_POOL::work, this));
+}
+
+THREAD_POOL::~THREAD_POOL()
+{
+  {
+    lock_guard<mutex> lock(_mutex);
+    _quit = true;
+  }
+  _wake.notify_all();
+
+  for (unsigned int x = 0; x < _workers.size(); x++)
+    _workers[x].join();
+}
+
+//////////////////////////////////////////////////////////////////////
+// run a job over all the threads
+//////////////////////////////////////////////////////////////////////
+void THREAD_POOL::run(int blocks, const function<void(int)>& task)
+{
+  // not worth waking anyone up
+  if (_workers.empty() || blocks <= 1)
+  {
+    for (int x = 0; x < blocks; x++)
+      task(x);
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(_mutex);
+    _task = &task;
+    _blocks = blocks;
+    _next = 0;
+    _busy = _workers.size();
+    _job++;
+  }
+  _wake.notify_all();
+
+  // help out, then wait for the stragglers
+  drain();
+  unique_lock<mutex> lock(_mutex);
+  while (_busy > 0)
+    _done.wait(lock);
+}
+
+//////////////////////////////////////////////////////////////////////
+// worker thread loop
+//////////////////////////////////////////////////////////////////////
+void THREAD_POOL::work()
+{
+  unsigned int lastJob = 0;
+  while (true)
+  {
+    {
+      unique_lock<mutex> lock(_mutex);
+      while (!_quit && _job == lastJob)
+        _wake.wait(lock);
+      if (_quit) return;
+      lastJob = _job;
+    }
+
+    drain();
+
+    lock_guard<mutex> lock(_mutex);
+    if (--_busy == 0)
+      _done.notify_one();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// run blocks of the current job until there are none left
+//////////////////////////////////////////////////////////////////////
+void THREAD_POOL::drain()
+{
+  for (int block = _next++; block < _blocks; block = _next++)
+    (*_task)(block);
+}
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////////
+// File : THREAD_POOL.h
+///////////////////////////////////////////////////////////////////////////////////
+//
+// LumosQuad - A Lightning Generator
+// Copyright 2007
+// The University of North Carolina at Chapel Hill
+// 
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+// 
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//  The University of North Carolina at Chapel Hill makes no representations 
+//  about the suitability of this software for any purpose. It is provided 
+//  "as is" without express or implied warranty.
+//
+//  Permission to use, copy, modify and distribute this software and its
+//  documentation for educational, research and non-profit purposes, without
+//  fee, and without a written agreement is hereby granted, provided that the
+//  above copyright notice and the following three paragraphs appear in all
+//  copies.
+//
+//  THE UNIVERSITY OF NORTH CAROLINA SPECIFICALLY DISCLAIM ANY WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+//  FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN
+//  "AS IS" BASIS, AND THE UNIVERSITY OF NORTH CAROLINA HAS NO OBLIGATION TO
+//  PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+//
+//  Please send questions and comments about LumosQuad to kim@cs.unc.edu.
+//
+///////////////////////////////////////////////////////////////////////////////////
+//
+//  This program uses OpenEXR, which has the following restrictions:
+// 
+//  Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+//  Digital Ltd. LLC
+// 
+//  All rights reserved.
+// 
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//  *       Redistributions of source code must retain the above copyright
+//  notice, this list of conditions and the following disclaimer.
+//  *       Redistributions in binary form must reproduce the above
+//  copyright notice, this list of conditions and the following disclaimer
+//  in the documentation and/or other materials provided with the
+//  distribution.
+//  *       Neither the name of Industrial Light & Magic nor the names of
+//  its contributors may be used to endorse or promote products derived
+//  from this software without specific prior written permission. 
+// 
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////
+/// \brief Fixed set of worker threads for data parallel loops
+///
+/// run() splits a loop into blocks and hands them out to whichever
+/// thread is free, with the calling thread helping out. Callers that
+/// reduce should write one partial result per block and combine them
+/// in block order afterwards, so the answer doesn't depend on how many
+/// threads there are.
+//////////////////////////////////////////////////////////////////////
+class THREAD_POOL
+{
+public:
+  /// \brief constructor
+  ///
+  /// \param threads      total threads, including the calling one
+  THREAD_POOL(int threads = 1);
+
+  //! destructor, joins the workers
+  ~THREAD_POOL();
+
+  //! total threads, including the calling one
+  int threads() { return _workers.size() + 1; };
+
+  /// \brief call task(block) for every block in [0, blocks)
+  ///
+  /// Returns once all the blocks are done.
+  void run(int blocks, const function<void(int)>& task);
+
+private:
+  vector<thread> _workers;
+
+  mutex _mutex;
+  condition_variable _wake;   ///< signals a new job or shutdown
+  condition_variable _done;   ///< signals the last worker finished
+
+  const function<void(int)>* _task;  ///< current job
+  int _blocks;                       ///< blocks in the current job
+  atomic<int> _next;                 ///< next block to hand out
+  int _busy;                         ///< workers still on the current job
+  unsigned int _job;                 ///< incremented for every job
+  bool _quit;                        ///< tells the workers to exit
+
+  //! worker thread loop
+  void work();
+
+  //! run blocks of the current job until there are none left
+  void drain();
+};
+
+#endif
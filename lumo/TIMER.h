@@ -1,5 +1,6 @@
 ///////////////////////////////////////////////////////////////////////////////////
-// File : CG_SOLVER_SSE.h
+// File : TIMER.h
+///////////////////////////////////////////////////////////////////////////////////
 //
 // LumosQuad - A Lightning Generator
 // Copyright 2007
@@ -62,42 +63,47 @@
 //  from this software without specific prior written permission. 
 // 
 
-#ifndef CG_SOLVER_SSE_H
-#define CG_SOLVER_SSE_H
+#ifndef TIMER_H
+#define TIMER_H
 
-#include "CG_SOLVER.h"
-#include <xmmintrin.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
 
-////////////////////////////////////////////////////////////////////
-/// \brief Conjugate gradient Poisson solver that exploits SSE.
-////////////////////////////////////////////////////////////////////
-class CG_SOLVER_SSE : public CG_SOLVER
+//////////////////////////////////////////////////////////////////////
+/// \brief Wall clock timer for benchmarking
+//////////////////////////////////////////////////////////////////////
+class TIMER
 {
 public:
-  //! constructor
-  CG_SOLVER_SSE(int maxDepth, int iterations = 10, int digits = 1);
-  //! destructor
-  ~CG_SOLVER_SSE();
+  //! constructor, starts the timer
+  TIMER() { start(); };
+
+  //! restart the timer
+  void start() { _start = now(); };
+
+  //! seconds elapsed since the timer was started
+  double elapsed() { return now() - _start; };
 
-  //! solve the Poisson problem using SSE
-  virtual int solve(list<CELL*> cells);
-  
 private:
-  //! reallocate the SSE-friendly scratch arrays
-  virtual void reallocate();
-  
-  // SSE linear algebra operators
-  inline float dotSSE(float* x, float* y);
-  inline void saxpySSE(float a, float* x, float* y);
-  inline void saypxSSE(float a, float* x, float* y);
-  inline float maxSSE(float* x);
-  inline void addSSE(float* x, float* y);
-  inline void multiplySSE(float* x, float* y);
-  inline void multiplySSE(float* x, float* y, float* z);
-  inline void multiplySubtractSSE(float* w, float* x, float* y, float* z);
-  inline void setSSE(float* x, float val);
-  inline void wipeSSE(float* x);
-  inline void copySSE(float* x, float* y);
+  //! start time in seconds
+  double _start;
+
+  //! current wall clock time in seconds
+  static double now() {
+#ifdef WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    timeval time;
+    gettimeofday(&time, NULL);
+    return time.tv_sec + time.tv_usec * 1e-6;
+#endif
+  };
 };
 
 #endif
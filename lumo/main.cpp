@@ -94,11 +94,21 @@
 #define COMMAND_LINE_VERSION 1
 
 #include <iostream>
-#include "ppm\ppm.hpp"
+#include <cstdio>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "ppm/ppm.hpp"
 #include "APSF.h"
 #include "FFT.h"
 #include "QUAD_DBM_2D.h"
 #include "EXR.h"
+#include "TIMER.h"
+#include "THREAD_POOL.h"
+#include <atomic>
+#include <mutex>
 
 using namespace std;
 
@@ -106,12 +116,6 @@ using namespace std;
 // globals
 ////////////////////////////////////////////////////////////////////////////
 int iterations = 10;
-static QUAD_DBM_2D* potential = new QUAD_DBM_2D(256, 256, iterations);
-APSF apsf(512);
-
-// input image info
-int inputWidth = -1;
-int inputHeight = -1;
 
 // input params
 string inputFile;
@@ -123,10 +127,57 @@ float scale = 5;
 // pause the simulation?
 bool pause = false;
 
+// run without a window?
+#ifndef NO_OPENGL
+bool headless = false;
+#else
+bool headless = true;
+#endif
+
+// compare the preconditioners instead of simulating?
+bool benchmark = false;
+
+// particles to grow before timing the solvers again on a developed bolt
+int benchmarkParticles = 1000;
+
+// preconditioner for the Poisson solves
+PRECONDITIONER preconditioner = NO_PRECONDITIONER;
+
+// solve with multigrid V-cycles instead of conjugate gradient?
+bool multigrid = false;
+
+// threads running the conjugate gradient sweeps
+int threads = 1;
+
+// how the blue noise attractors are generated
+NOISE_GENERATOR noiseGenerator = BOUNDARY_SAMPLING;
+
+// look up quadtree cells by Morton key instead of walking the tree?
+bool linearTree = false;
+
+// dielectric breakdown exponent
+float eta = 1.0f;
+
+// simulate a range of seeds instead of one bolt?
+bool batch = false;
+int firstSeed = 0;
+int lastSeed = 0;
+
+// control pixels of an input image, split up by color
+struct CONTROLS
+{
+  int width;
+  int height;
+  vector<unsigned char> start;
+  vector<unsigned char> repulsor;
+  vector<unsigned char> attractor;
+  vector<unsigned char> terminators;
+};
+
 ////////////////////////////////////////////////////////////////////////////
-// render the glow
+// render the glow with a prepared filter
 ////////////////////////////////////////////////////////////////////////////
-void renderGlow(string filename, int scale = 1)
+bool renderGlow(QUAD_DBM_2D* potential, const FFT& filter, string filename, int scale)
 {
   int w = potential->xDagRes() * scale;
   int h = potential->yDagRes() * scale;
@@ -134,19 +185,10 @@ void renderGlow(string filename, int scale = 1)
   // draw the DAG
   float*& source = potential->renderOffscreen(scale);
   
-  // if there is no input dimensions specified, else there were input
-  // image dimensions, so crop it
-  if (inputWidth == -1)
-  {
-    inputWidth  = potential->inputWidth();
-    inputHeight = potential->inputHeight();
-  }
-
-  // copy out the cropped version
-  int wCropped = inputWidth * scale;
-  int hCropped = inputHeight * scale;
+  // copy out the version cropped to the input image dimensions
+  int wCropped = potential->inputWidth() * scale;
+  int hCropped = potential->inputHeight() * scale;
   float* cropped = new float[wCropped * hCropped];
-  cout << endl << " Generating EXR image width: " << wCropped << " height: " << hCropped << endl;
   for (int y = 0; y < hCropped; y++)
     for (int x = 0; x < wCropped; x++)
     {
@@ -155,65 +197,326 @@ void renderGlow(string filename, int scale = 1)
       cropped[croppedIndex] = source[uncroppedIndex];
     }
 
-  // create the filter
-  apsf.generateKernelFast();
- 
   // convolve with FFT
-  bool success = FFT::convolve(cropped, apsf.kernel(), wCropped, hCropped, apsf.res(), apsf.res());
+  bool success = filter.convolve(cropped);
    
-  if (success) {
+  if (success)
     EXR::writeEXR(filename.c_str(), cropped, wCropped, hCropped);
+    
+  delete[] cropped;
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// render the glow
+////////////////////////////////////////////////////////////////////////////
+void renderGlow(QUAD_DBM_2D* potential, string filename, int scale = 1)
+{
+  int wCropped = potential->inputWidth() * scale;
+  int hCropped = potential->inputHeight() * scale;
+  cout << endl << " Generating EXR image width: " << wCropped << " height: " << hCropped << endl;
+
+  // create the filter
+  APSF apsf(512);
+  apsf.generateKernelFast();
+  FFT filter(apsf.kernel(), apsf.res(), apsf.res(), wCropped, hCropped);
+ 
+  if (renderGlow(potential, filter, filename, scale))
     cout << " " << filename << " written." << endl;
-  }
   else
     cout << " Final image generation failed." << endl;
-    
-  delete[] cropped;
 }
 
 ////////////////////////////////////////////////////////////////////////////
-// load image file into the DBM simulation
+// read the control pixels out of a *.ppm file
 ////////////////////////////////////////////////////////////////////////////
-bool loadImages(string inputFile)
+bool readControls(string inputFile, CONTROLS& controls)
 {
   // load the files
   unsigned char* input = NULL;
-  LoadPPM(inputFile.c_str(), input, inputWidth, inputHeight);
-
-  unsigned char* start       = new unsigned char[inputWidth * inputHeight];
-  unsigned char* repulsor    = new unsigned char[inputWidth * inputHeight];
-  unsigned char* attractor   = new unsigned char[inputWidth * inputHeight];
-  unsigned char* terminators = new unsigned char[inputWidth * inputHeight];
+  LoadPPM(inputFile.c_str(), input, controls.width, controls.height);
+  if (!input)
+    return false;
+
+  int size = controls.width * controls.height;
+  controls.start.resize(size);
+  controls.repulsor.resize(size);
+  controls.attractor.resize(size);
+  controls.terminators.resize(size);
   
   // composite RGB channels into one
-  for (int x = 0; x < inputWidth * inputHeight; x++)
+  for (int x = 0; x < size; x++)
   {
-    start[x]     = (input[3 * x] == 255)     ? 255 : 0;
-    repulsor[x]  = (input[3 * x + 1] == 255) ? 255 : 0;
-    attractor[x] = (input[3 * x + 2] == 255) ? 255 : 0;
-    terminators[x] = 0;
+    controls.start[x]     = (input[3 * x] == 255)     ? 255 : 0;
+    controls.repulsor[x]  = (input[3 * x + 1] == 255) ? 255 : 0;
+    controls.attractor[x] = (input[3 * x + 2] == 255) ? 255 : 0;
+    controls.terminators[x] = 0;
     
     if (input[3 * x] + input[3 * x + 1] + input[3 * x + 2] == 255 * 3)
     {
-      terminators[x] = 255;
-      start[x] = repulsor[x] = attractor[x] = 0;
+      controls.terminators[x] = 255;
+      controls.start[x] = controls.repulsor[x] = controls.attractor[x] = 0;
     }
   }
 
-  if (potential) delete potential;
-  potential = new QUAD_DBM_2D(inputWidth, inputHeight, iterations);
-  bool success = potential->readImage(start, attractor, repulsor, terminators, inputWidth, inputHeight);
-  
-  // delete the memory
   delete[] input;
-  delete[] start;
-  delete[] repulsor;
-  delete[] attractor;
-  delete[] terminators;
+  return size > 0;
+}
 
-  return success;
+////////////////////////////////////////////////////////////////////////////
+// start a new DBM simulation, NULL if the controls are not valid
+////////////////////////////////////////////////////////////////////////////
+QUAD_DBM_2D* createSimulation(CONTROLS& controls, const NOISE_MASK* noise = NULL, 
+                              int solverThreads = threads)
+{
+  QUAD_DBM_2D* potential = new QUAD_DBM_2D(controls.width, controls.height, iterations, noise,
+                                           noiseGenerator, solverThreads);
+  potential->quadPoisson()->solver()->preconditioner() = preconditioner;
+  potential->quadPoisson()->solver()->standalone() = multigrid;
+  potential->quadPoisson()->solver()->setThreads(solverThreads);
+  potential->quadPoisson()->useLinearTree(linearTree);
+  potential->eta() = eta;
+  bool success = potential->readImage(&controls.start[0], &controls.attractor[0], 
+                                      &controls.repulsor[0], &controls.terminators[0], 
+                                      controls.width, controls.height);
+  if (!success)
+  {
+    delete potential;
+    return NULL;
+  }
+  return potential;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// load image file into a new DBM simulation, NULL if it is not valid
+////////////////////////////////////////////////////////////////////////////
+QUAD_DBM_2D* loadImages(string inputFile)
+{
+  CONTROLS controls;
+  if (!readControls(inputFile, controls))
+    return NULL;
+  return createSimulation(controls);
+}
+
+////////////////////////////////////////////////////////////////////////////
+// write the intermediate file and render the final EXR image
+////////////////////////////////////////////////////////////////////////////
+void writeResults(QUAD_DBM_2D* potential)
+{
+  cout << endl << endl;
+
+  // write out the DAG file
+  string lightningFile = inputFile.substr(0, inputFile.size() - 3) + string("lightning");
+  cout << " Intermediate file " << lightningFile << " written." << endl;
+  potential->writeDAG(lightningFile.c_str());
+  
+  // render the final EXR file
+  renderGlow(potential, outputFile, scale);
+}
+
+////////////////////////////////////////////////////////////////////////////
+// add particles until the simulation hits a terminator
+////////////////////////////////////////////////////////////////////////////
+bool simulate(QUAD_DBM_2D* potential)
+{
+  while (!potential->hitGround())
+    if (!potential->addParticle())
+    {
+      cout << " No nodes left to add! Is your terminator reachable?" << endl;
+      return false;
+    }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// run the simulation without a window until it hits a terminator
+////////////////////////////////////////////////////////////////////////////
+int headlessMain(QUAD_DBM_2D* potential)
+{
+  bool success = simulate(potential);
+  if (success)
+    writeResults(potential);
+  delete potential;
+  
+  return success ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// time full precision solves with each solver from the same starting
+// potentials, repeated until the timing settles, and report the median
+////////////////////////////////////////////////////////////////////////////
+void benchmarkSolvers(QUAD_POISSON* quadPoisson)
+{
+  const char* names[] = {"cg", "cg-jacobi", "cg-ic", "cg-multigrid", "multigrid"};
+  PRECONDITIONER preconditioners[] = {NO_PRECONDITIONER, JACOBI, INCOMPLETE_CHOLESKY, 
+                                      MULTIGRID, NO_PRECONDITIONER};
+
+  MG_SOLVER* solver = quadPoisson->solver();
+  vector<CELL*>& leaves = quadPoisson->getEmptyLeaves();
+  vector<float> start(leaves.size());
+  for (unsigned int y = 0; y < leaves.size(); y++)
+    start[y] = leaves[y]->potential;
+
+  cout << " solver           iterations   max residual       seconds    runs" << endl;
+  for (int x = 0; x < 5; x++)
+  {
+    solver->preconditioner() = preconditioners[x];
+    solver->standalone() = (x == 4);
+    solver->iterations() = 10000;
+
+    // the first solve assembles the system from scratch and isn't
+    // timed, the tree doesn't change after that
+    vector<CELL*> unchanged;
+    vector<double> seconds;
+    int solveIterations = 0;
+    TIMER total;
+    for (int run = -1; run < 5 || (total.elapsed() < 1.0 && run < 1000); run++)
+    {
+      for (unsigned int y = 0; y < leaves.size(); y++)
+        leaves[y]->potential = start[y];
+
+      TIMER timer;
+      solveIterations = solver->solve(leaves, (run < 0) ? NULL : &unchanged);
+      if (run >= 0)
+        seconds.push_back(timer.elapsed());
+      else
+        total.start();
+    }
+    sort(seconds.begin(), seconds.end());
+
+    printf(" %-14s   %10i   %12g   %11.6f   %5i\n", names[x], solveIterations, 
+           solver->calcResidual(), seconds[seconds.size() / 2], (int)seconds.size());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////
+// compare the solvers on the freshly seeded tree and again once the
+// bolt has grown for a while
+////////////////////////////////////////////////////////////////////////////
+int benchmarkMain()
+{
+  QUAD_DBM_2D* potential = loadImages(inputFile);
+  if (!potential)
+    return 1;
+  QUAD_POISSON* quadPoisson = potential->quadPoisson();
+
+  cout << endl;
+  cout << " Seeded tree, " << quadPoisson->getEmptyLeaves().size() << " unknowns" << endl;
+  benchmarkSolvers(quadPoisson);
+
+  // grow with the solver picked on the command line
+  quadPoisson->solver()->preconditioner() = preconditioner;
+  quadPoisson->solver()->standalone() = multigrid;
+  potential->verbose() = false;
+  int particles = 0;
+  while (particles < benchmarkParticles && !potential->hitGround() && potential->addParticle())
+    particles++;
+
+  cout << endl;
+  cout << " After " << particles << " particles, " 
+       << quadPoisson->getEmptyLeaves().size() << " unknowns" << endl;
+  benchmarkSolvers(quadPoisson);
+
+  delete potential;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// output file name for one seed of a batch
+////////////////////////////////////////////////////////////////////////////
+string batchName(string pattern, int seed)
+{
+  // fill in a %d, optionally zero padded like %04d
+  size_t percent = pattern.find('%');
+  if (percent != string::npos)
+  {
+    size_t end = percent + 1;
+    while (end < pattern.size() && isdigit(pattern[end]))
+      end++;
+    if (end < pattern.size() && pattern[end] == 'd')
+    {
+      string format = pattern.substr(percent, end - percent + 1);
+      char number[64];
+      snprintf(number, sizeof(number), format.c_str(), seed);
+      return pattern.substr(0, percent) + number + pattern.substr(end + 1);
+    }
+  }
+
+  // otherwise tack the seed on before the extension
+  char number[32];
+  snprintf(number, sizeof(number), "_%d", seed);
+  size_t dot = pattern.rfind('.');
+  if (dot == string::npos)
+    return pattern + number;
+  return pattern.substr(0, dot) + number + pattern.substr(dot);
+}
+
+////////////////////////////////////////////////////////////////////////////
+// simulate and render one bolt per seed, several at a time
+////////////////////////////////////////////////////////////////////////////
+int batchMain()
+{
+  TIMER timer;
+  CONTROLS controls;
+  if (!readControls(inputFile, controls))
+  {
+    cout << " ERROR: " << inputFile.c_str() << " is not a valid PPM file." << endl;
+    return 1;
+  }
+
+  // everything the bolts have in common is built once and only read
+  // after this
+  int res = (int)pow(2.0f, (float)QUAD_POISSON::depthFor(controls.width, controls.height));
+  NOISE_MASK noise(res, noiseGenerator, threads);
+  APSF apsf(512);
+  apsf.generateKernelFast();
+  FFT filter(apsf.kernel(), apsf.res(), apsf.res(), 
+             controls.width * (int)scale, controls.height * (int)scale);
+  cout << " Shared blue noise and glow filter built in " << timer.elapsed() << " seconds." << endl;
+
+  // each thread runs a whole bolt at a time and grabs the next seed
+  // when it finishes, so slow bolts don't hold up the rest
+  int bolts = lastSeed - firstSeed + 1;
+  atomic<int> written(0);
+  mutex outputMutex;
+  THREAD_POOL pool(threads);
+  cout << " Simulating " << bolts << " bolts on " << pool.threads() << " threads." << endl;
+  pool.run(bolts, [&](int x) {
+    int seed = firstSeed + x;
+    string exrFile = batchName(outputFile, seed);
+    string lightningFile = exrFile.substr(0, exrFile.rfind('.')) + string(".lightning");
+
+    QUAD_DBM_2D* potential = createSimulation(controls, &noise, 1);
+    bool success = (potential != NULL);
+    if (success)
+    {
+      potential->verbose() = false;
+      potential->seed(seed);
+      success = simulate(potential);
+    }
+    if (success)
+    {
+      potential->writeDAG(lightningFile.c_str());
+      success = renderGlow(potential, filter, exrFile, (int)scale);
+    }
+    delete potential;
+
+    if (success) written++;
+    lock_guard<mutex> lock(outputMutex);
+    cout << " " << exrFile << (success ? " written." : " failed.") << endl;
+  });
+
+  double seconds = timer.elapsed();
+  cout << endl << " " << written << " of " << bolts << " bolts in " << seconds << " seconds, "
+       << 60.0 * written / seconds << " bolts per minute." << endl;
+  
+  return (written == bolts) ? 0 : 1;
 }
 
+#ifndef NO_OPENGL
+// the simulation shown in the window
+QUAD_DBM_2D* windowPotential = NULL;
+
 int width  = 600;
 int height = 600;
 bool animate = false;
@@ -252,8 +555,8 @@ void Display()
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
   
-  potential->draw();
-  potential->drawSegments();
+  windowPotential->draw();
+  windowPotential->drawSegments();
   
   glutSwapBuffers();
 }
@@ -286,7 +589,7 @@ void Idle()
   if (!pause)
     for (int x = 0; x < 100; x++)
     {
-      bool success = potential->addParticle();
+      bool success = windowPotential->addParticle();
 
       if (!success)
       {
@@ -295,19 +598,11 @@ void Idle()
         return;
       }
       
-      if (potential->hitGround())
+      if (windowPotential->hitGround())
       {
         glutPostRedisplay();
-        cout << endl << endl;
-
-        // write out the DAG file
-        string lightningFile = inputFile.substr(0, inputFile.size() - 3) + string("lightning");
-        cout << " Intermediate file " << lightningFile << " written." << endl;
-        potential->writeDAG(lightningFile.c_str());
-        
-        // render the final EXR file
-        renderGlow(outputFile, scale);
-        delete potential;
+        writeResults(windowPotential);
+        delete windowPotential;
         exit(0);
       }
     }
@@ -317,8 +612,10 @@ void Idle()
 ////////////////////////////////////////////////////////////////////////////
 // GLUT Main 
 ////////////////////////////////////////////////////////////////////////////
-int glutMain()
+int glutMain(QUAD_DBM_2D* potential)
 { 
+  windowPotential = potential;
+
   float smaller = 1.0f;
   camera[0] = smaller * 0.5f;
   camera[1] = smaller * 0.5f;
@@ -346,17 +643,106 @@ int glutMain()
 
   return 0;
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////
 // Main 
 ////////////////////////////////////////////////////////////////////////////
 int main(int argc, char **argv)
 {
-  if (argc < 3)
+  // peel off the optional flags
+  vector<string> args;
+  for (int x = 1; x < argc; x++)
+  {
+    string arg(argv[x]);
+    if (arg == string("-headless"))
+      headless = true;
+    else if (arg == string("-benchmark"))
+      benchmark = true;
+    else if (arg == string("-multigrid"))
+      multigrid = true;
+    else if (arg == string("-kernels") && x + 1 < argc)
+    {
+      if (!CG_KERNELS::select(argv[++x]))
+        cout << " " << argv[x] << " kernels are not available on this machine." << endl;
+    }
+    else if (arg == string("-batch") && x + 2 < argc)
+    {
+      batch = true;
+      firstSeed = atoi(argv[++x]);
+      lastSeed = atoi(argv[++x]);
+      if (lastSeed < firstSeed) lastSeed = firstSeed;
+    }
+    else if (arg == string("-eta") && x + 1 < argc)
+    {
+      char* end;
+      float value = strtof(argv[++x], &end);
+      if (end != argv[x] && *end == '\0' && std::isfinite(value) && value > 0.0f)
+        eta = value;
+      else
+        cout << " " << argv[x] << " is not a valid eta, it must be a number greater than 0." << endl;
+    }
+    else if (arg == string("-threads") && x + 1 < argc)
+    {
+      threads = atoi(argv[++x]);
+      if (threads < 1) threads = 1;
+    }
+    else if (arg == string("-tree") && x + 1 < argc)
+      linearTree = (string(argv[++x]) == string("linear"));
+    else if (arg == string("-noise") && x + 1 < argc)
+    {
+      string name(argv[++x]);
+      if (name == string("parallel"))
+        noiseGenerator = PARALLEL_TILES;
+      else if (name == string("boundary"))
+        noiseGenerator = BOUNDARY_SAMPLING;
+      else
+        cout << " " << name << " is not a blue noise generator, use boundary or parallel." << endl;
+    }
+    else if (arg == string("-precondition") && x + 1 < argc)
+    {
+      string name(argv[++x]);
+      if (name == string("jacobi"))
+        preconditioner = JACOBI;
+      else if (name == string("ic"))
+        preconditioner = INCOMPLETE_CHOLESKY;
+      else if (name == string("multigrid"))
+        preconditioner = MULTIGRID;
+      else if (name == string("none"))
+        preconditioner = NO_PRECONDITIONER;
+      else
+        cout << " " << name << " is not a preconditioner, use none, jacobi, ic or multigrid." << endl;
+    }
+    else
+      args.push_back(arg);
+  }
+
+  if (args.size() < 2 && !(benchmark && args.size() == 1))
   {
     cout << endl;
-    cout << "   LumosQuad <input file> <output file> <scale (optional)>" << endl;
-    cout << "   =========================================================" << endl;
+    cout << "   LumosQuad [-headless] [-benchmark] [-multigrid] [-precondition <type>]" << endl;
+    cout << "             [-kernels <type>] [-threads <count>] [-eta <exponent>]" << endl;
+    cout << "             [-noise <type>] [-tree <type>] [-batch <first seed> <last seed>]" << endl;
+    cout << "             <input file> <output file> <scale (optional)>" << endl;
+    cout << "   ====================================================================" << endl;
+    cout << "      -headless     - Run the simulation without a window" << endl;
+    cout << "      -benchmark    - Time full precision solves with each solver, on" << endl;
+    cout << "                      the seeded tree and after 1000 particles" << endl;
+    cout << "      -multigrid    - Solve with multigrid instead of conjugate gradient" << endl;
+    cout << "      -precondition - Conjugate gradient preconditioner: none, jacobi," << endl;
+    cout << "                      ic or multigrid" << endl;
+    cout << "      -kernels      - Force the vector kernels: scalar, avx2 or avx512" << endl;
+    cout << "      -threads      - Threads for the conjugate gradient sweeps, the" << endl;
+    cout << "                      output is the same for any count. With -batch," << endl;
+    cout << "                      the number of bolts simulated at once" << endl;
+    cout << "      -eta          - Dielectric breakdown exponent, higher gives less" << endl;
+    cout << "                      branching, lower gives bushier bolts (default 1)" << endl;
+    cout << "      -noise        - Blue noise generator: boundary (default) or" << endl;
+    cout << "                      parallel, which splits tiles over -threads threads" << endl;
+    cout << "      -tree         - Quadtree lookups: pointer (default) walks the" << endl;
+    cout << "                      tree, linear uses a Morton-keyed hash" << endl;
+    cout << "      -batch        - Simulate one bolt per seed. %d or %04d in the" << endl;
+    cout << "                      output file is replaced by the seed" << endl;
     cout << "      <input file>  - *.ppm file with input colors" << endl;
     cout << "                      --OR--" << endl;
     cout << "                      *.lightning file from a previous run" << endl;
@@ -369,11 +755,15 @@ int main(int argc, char **argv)
 
   cout << endl << "Lumos: A lightning generator v0.1" << endl;
   cout << "------------------------------------------------------" << endl;
+  cout << " Using " << CG_KERNELS::current().name << " vector kernels";
+  if (threads > 1 && !batch)
+    cout << " on " << threads << " threads";
+  cout << "." << endl;
 
   // store the input params
-  inputFile = string(argv[1]);
-  outputFile = string(argv[2]);
-  if (argc > 3) scale = atoi(argv[3]);
+  inputFile = args[0];
+  if (args.size() > 1) outputFile = args[1];
+  if (args.size() > 2) scale = atoi(args[2].c_str());
  
   // see if the input is a *.lightning file
   if (inputFile.size() > 10)
@@ -383,15 +773,25 @@ int main(int argc, char **argv)
     cout << " Using intermediate file " << inputFile << endl;
     if (postfix == string("lightning"))
     {
+      QUAD_DBM_2D* potential = new QUAD_DBM_2D(256, 256, iterations);
       potential->readDAG(inputFile.c_str());
-      renderGlow(outputFile, scale);
+      renderGlow(potential, outputFile, scale);
       delete potential;
       return 0;
     }
   }
   
+  // compare the solvers on the *.ppm input file
+  if (benchmark)
+    return benchmarkMain();
+
+  // make many bolts from the *.ppm input file
+  if (batch)
+    return batchMain();
+
   // read in the *.ppm input file
-  if (!loadImages(inputFile))
+  QUAD_DBM_2D* potential = loadImages(inputFile);
+  if (!potential)
   {
     cout << " ERROR: " << inputFile.c_str() << " is not a valid PPM file." << endl;
     return 1;
@@ -401,7 +801,11 @@ int main(int argc, char **argv)
 
   // loop simulation until it hits a terminator
   cout << " Total particles added: ";
-  glutMain();
+  if (headless)
+    return headlessMain(potential);
+#ifndef NO_OPENGL
+  glutMain(potential);
+#endif
 
   return 0;
 }